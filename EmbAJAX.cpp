@@ -23,59 +23,293 @@
 #define EMBAJAX_OUTUPUTDRIVER_IMPLEMENTATION
 
 #include "EmbAJAX.h"
+#include "EmbAJAXGzip.h"
 
 #include <stdarg.h> // For va_args in _printContentF.
 
-#define ITOA_BUFLEN 8
-
 // statics
 EmbAJAXOutputDriverBase *EmbAJAXBase::_driver;
-char EmbAJAXBase::itoa_buf[ITOA_BUFLEN];
+EMBAJAX_THREAD_LOCAL EmbAJAXOutputContext* EmbAJAXOutputDriverBase::_context = 0;
 constexpr const char EmbAJAXBase::null_string[1];
+constexpr size_t EmbAJAXElementIndex::npos;
+
+// Shared buffer for the value() of elements with numeric values. Not used internally, see EmbAJAXElement::formatValue()
+static char value_buf[EMBAJAX_VALUE_BUFLEN];
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// Write the decimal representation of value into buf (at least EMBAJAX_VALUE_BUFLEN bytes). Returns the length (excluding the terminating 0).
+static size_t formatInteger(int32_t value, char* buf) {
+    char digits[10];
+    uint8_t n = 0;
+    uint32_t v = (value < 0) ? -(uint32_t) value : value;
+    do {
+        digits[n++] = '0' + (v % 10);
+        v /= 10;
+    } while (v);
+    size_t len = 0;
+    if (value < 0) buf[len++] = '-';
+    while (n) buf[len++] = digits[--n];
+    buf[len] = '\0';
+    return len;
+}
 
 ////////////////////////////// EmbAJAXOutputDriverBase ////////////////////
 
+// Classes of characters that need escaping, depending on the QuoteMode (see _printFiltered())
+enum {
+    EscapeJS = 1,          // '"', '\\', and newline, in JSQuoted and JSEscaped
+    EscapeHTMLQuote = 2,   // '"', in HTMLQuoted
+    EscapeHTML = 4         // '<' and '&', if HTML escaping is requested
+};
+
+// Escape class of each character up to '\\'. All others never need escaping.
+#if USE_PROGMEM_STRINGS
+static const uint8_t escape_classes[] PROGMEM = {
+#define ESCAPE_CLASS(c) pgm_read_byte(escape_classes + (uint8_t) (c))
+#else
+static const uint8_t escape_classes[] = {
+#define ESCAPE_CLASS(c) escape_classes[(uint8_t) (c)]
+#endif
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, EscapeJS, 0, 0, 0, 0, 0,                            // 0x00 - 0x0F
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,                                   // 0x10 - 0x1F
+    0, 0, EscapeJS | EscapeHTMLQuote, 0, 0, 0, EscapeHTML, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x20 - 0x2F
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, EscapeHTML, 0, 0, 0,                          // 0x30 - 0x3F
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,                                   // 0x40 - 0x4F
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, EscapeJS                                      // 0x50 - 0x5C
+};
+
+static inline bool needsEscaping(char c, uint8_t mask) {
+    return ((uint8_t) c <= '\\') && (ESCAPE_CLASS(c) & mask);
+}
+
+#if !defined(__AVR__)
+// Non-zero, if any byte of word equals c (see "Bit Twiddling Hacks", "Determine if a word has a byte equal to n")
+static inline uint32_t hasByte(uint32_t word, uint8_t c) {
+    uint32_t x = word ^ (0x01010101UL * c);
+    return (x - 0x01010101UL) & ~x & 0x80808080UL;
+}
+#endif
+
+// Returns the first character in [pos, end) needing escaping for the given mask, or end
+static const char* findEscape(const char* pos, const char* end, uint8_t mask) {
+#if !defined(__AVR__)
+    // Check four bytes at a time, and leave the exact position to the loop below
+    while (end - pos >= 4) {
+        uint32_t word;
+        memcpy(&word, pos, 4);
+        uint32_t hit = 0;
+        if (mask & EscapeJS) hit |= hasByte(word, '"') | hasByte(word, '\\') | hasByte(word, '\n');
+        if (mask & EscapeHTMLQuote) hit |= hasByte(word, '"');
+        if (mask & EscapeHTML) hit |= hasByte(word, '<') | hasByte(word, '&');
+        if (hit) break;
+        pos += 4;
+    }
+#endif
+    while (pos < end && !needsEscaping(*pos, mask)) ++pos;
+    return pos;
+}
+
 void EmbAJAXOutputDriverBase::_printFiltered(const char* value, QuoteMode quoted, bool HTMLescaped) {
-    if (quoted) _printChar('"');
+    bool js = (quoted == JSQuoted) || (quoted == JSEscaped);
+    uint8_t mask = (js ? EscapeJS : 0) | ((quoted == HTMLQuoted) ? EscapeHTMLQuote : 0) | (HTMLescaped ? EscapeHTML : 0);
+    if (quoted == JSQuoted || quoted == HTMLQuoted) _printChar('"');
     const char *pos = value;
-    while(*pos != '\0') {
-        if ((quoted == JSQuoted) && (*pos == '"' || *pos == '\\')) {
-            _printChar('\\');
-            _printChar(*pos);
-        } else if ((quoted == HTMLQuoted) && (*pos == '"')) {
-            _printContent("&quot;");
-        } else if (HTMLescaped && (*pos == '<')) {
-            _printContent("&lt;");
-        } else if (HTMLescaped && (*pos == '&')) {
-            _printContent("&amp;");
+    const char *end = value + strlen(value);
+    while (pos < end) {
+        // Copy runs of characters not needing escaping in one go
+        const char *next = mask ? findEscape(pos, end, mask) : end;
+        if (next > pos) _printStatic(pos, next - pos);
+        if (next == end) break;
+
+        const char c = *next;
+        if (js && (c == '"' || c == '\\')) {
+            const char escaped[2] = { '\\', c };
+            _printStatic(escaped, 2);
+        } else if (js && (c == '\n')) {
+            _printStatic("\\n", 2);
+        } else if (c == '"') {
+            _printStatic("&quot;", 6);
+        } else if (c == '<') {
+            _printStatic("&lt;", 4);
         } else {
-            _printChar(*pos);
+            _printStatic("&amp;", 5);
         }
-        ++pos;
+        pos = next + 1;
+    }
+    if (quoted == JSQuoted || quoted == HTMLQuoted) _printChar('"');
+}
+
+void EmbAJAXOutputDriverBase::emit(EmbAJAXOutputContext* ctx, const char* content, size_t len) {
+    ctx->_emitted += len;
+    if (ctx->_measuring) {
+        if (ctx->_hashing) {
+            // FNV-1a, see EmbAJAXBase::layoutVersion()
+            for (size_t i = 0; i < len; ++i) ctx->_hash = (ctx->_hash ^ (uint8_t) content[i]) * 16777619u;
+        }
+        if (ctx->_capture && ctx->_content_length < ctx->_capture_size) {
+            memcpy(ctx->_capture + ctx->_content_length, content, min(len, ctx->_capture_size - ctx->_content_length));
+        }
+        ctx->_content_length += len;
+    } else {
+#if EMBAJAX_USE_GZIP
+        if (ctx->_compressing) {
+            _gzip->write(content, len);
+            return;
+        }
+#endif
+        _sendContent(content, len);
+    }
+}
+
+void EmbAJAXOutputDriverBase::flush() {
+    EmbAJAXOutputContext* ctx = context();
+    commitBuffer(ctx);
+#if EMBAJAX_USE_GZIP
+    if (ctx->_compressing) {
+        _gzip->finish();
+        lock();
+        _gzip_user = 0;
+        unlock();
     }
-    if (quoted) _printChar('"');
+#endif
+    ctx->_compressing = false;
+    ctx->_content_length = 0;
+    ctx->_etag[0] = '\0';
+#if EMBAJAX_METRICS
+    if (ctx->_response_type != EmbAJAXMetrics::None) {
+        uint32_t time = micros() - ctx->_response_start;
+        lock();
+        _metrics.record(ctx->_response_type, time, ctx->_sent_bytes, ctx->_sent_calls, millis());
+        unlock();
+        ctx->_response_type = EmbAJAXMetrics::None;
+    }
+    ctx->_sent_bytes = 0;
+    ctx->_sent_calls = 0;
+#endif
+}
+
+bool EmbAJAXOutputDriverBase::checkPageETag(EmbAJAXPageBase* page, const char* if_none_match) {
+    EmbAJAXOutputContext* ctx = context();
+    uint32_t version = page->layoutVersion();
+    ctx->_etag[0] = '"';
+    for (int i = 8; i >= 1; --i) {
+        ctx->_etag[i] = hex_digits[version & 0x0F];
+        version >>= 4;
+    }
+    ctx->_etag[9] = '"';
+    ctx->_etag[10] = '\0';
+    // NOTE: The header may hold a list of ETags. Ours will be among them, with quotes, if at all.
+    bool match = if_none_match && strstr(if_none_match, ctx->_etag);
+    if (match) beginResponse(EmbAJAXMetrics::PageLoad);  // printPage() won't be called for this one
+    return match;
+}
+
+bool EmbAJAXOutputDriverBase::setCompressionEnabled(bool enabled) {
+#if EMBAJAX_USE_GZIP
+    if (enabled && !_gzip) _gzip = new EmbAJAXGzip(this);
+    if (!enabled && _gzip) {
+        delete (_gzip);
+        _gzip = 0;
+    }
+    return (_gzip != 0) == enabled;
+#else
+    UNUSED(enabled);
+    return !enabled;
+#endif
 }
 
-void EmbAJAXOutputDriverBase::commitBuffer() {
-    _buf[_bufpos] = '\0';
-    printContent(_buf);
-    _bufpos = 0;
+bool EmbAJAXOutputDriverBase::beginCompression(bool client_accepts_gzip) {
+    EmbAJAXOutputContext* ctx = context();
+#if EMBAJAX_USE_GZIP
+    lock();
+    ctx->_compressing = _gzip && client_accepts_gzip && !_gzip_user;  // if the compressor is busy with another response, send this one uncompressed
+    if (ctx->_compressing) _gzip_user = ctx;
+    unlock();
+    if (ctx->_compressing) _gzip->begin();
+#else
+    UNUSED(client_accepts_gzip);
+#endif
+    return ctx->_compressing;
+}
+
+void EmbAJAXOutputDriverBase::commitBuffer(EmbAJAXOutputContext* ctx) {
+    if (ctx->_bufpos) emit(ctx, ctx->_buf, ctx->_bufpos);  // NOTE: Never pass empty content. There seems to be a bug in the ESP8266 server when sending empty string.
+    ctx->_bufpos = 0;
+}
+
+void EmbAJAXOutputDriverBase::beginMeasuring(char* capture, size_t capture_size) {
+    EmbAJAXOutputContext* ctx = context();
+    commitBuffer(ctx);
+    ctx->_measuring = true;
+    ctx->_content_length = 0;
+    ctx->_capture = capture;
+    ctx->_capture_size = capture_size;
+}
+
+void EmbAJAXOutputDriverBase::endMeasuring() {
+    EmbAJAXOutputContext* ctx = context();
+    commitBuffer(ctx);
+    ctx->_measuring = false;
+    ctx->_capture = 0;
+}
+
+void EmbAJAXOutputDriverBase::printResponse(bool html, const char* content, size_t len) {
+    EmbAJAXOutputContext* ctx = context();
+    commitBuffer(ctx);
+    ctx->_content_length = len;
+    printHeader(html);
+    emit(ctx, content, len);
+    flush();
 }
 
 void EmbAJAXOutputDriverBase::_printChar(const char value) {
-    if (_bufpos >= 63) commitBuffer();
-    _buf[_bufpos++] = value;
+    EmbAJAXOutputContext* ctx = context();
+    if (ctx->_bufpos >= EMBAJAX_OUTPUT_BUFFER_SIZE) commitBuffer(ctx);
+    ctx->_buf[ctx->_bufpos++] = value;
 }
 
 void EmbAJAXOutputDriverBase::_printContent(const char* value) {
-    // NOTE: The assumption, here is that frequent (char-by-char) calls to printContent() _could_ be expensive, depending on the server
+    _printStatic(value, strlen(value));
+}
+
+void EmbAJAXOutputDriverBase::_printInteger(int32_t value) {
+    // Format right into the output buffer
+    static_assert(EMBAJAX_OUTPUT_BUFFER_SIZE >= EMBAJAX_VALUE_BUFLEN, "EMBAJAX_OUTPUT_BUFFER_SIZE is too small");
+    EmbAJAXOutputContext* ctx = context();
+    if (ctx->_bufpos + EMBAJAX_VALUE_BUFLEN > EMBAJAX_OUTPUT_BUFFER_SIZE) commitBuffer(ctx);
+    ctx->_bufpos += formatInteger(value, ctx->_buf + ctx->_bufpos);
+}
+
+void EmbAJAXOutputDriverBase::_printStatic(const char* value, size_t len) {
+    // NOTE: The assumption, here is that frequent (small) calls to printContent() _could_ be expensive, depending on the server
     //       implementation. Thus, a buffer is used to enable printing in larger chunks.
-    const char *pos = value;
-    while(*pos != '\0') {
-        _printChar(*pos);
-        ++pos;
+    EmbAJAXOutputContext* ctx = context();
+    if (len >= EMBAJAX_OUTPUT_BUFFER_SIZE) {
+        // No point in copying this into the buffer, just to pass it on, right away
+        commitBuffer(ctx);
+        emit(ctx, value, len);
+        return;
+    }
+    if (ctx->_bufpos + len > EMBAJAX_OUTPUT_BUFFER_SIZE) commitBuffer(ctx);
+    memcpy(ctx->_buf + ctx->_bufpos, value, len);
+    ctx->_bufpos += len;
+}
+
+#if USE_PROGMEM_STRINGS
+void EmbAJAXOutputDriverBase::_printStaticP(PGM_P value, size_t len) {
+    // Copy straight from flash into the output buffer
+    EmbAJAXOutputContext* ctx = context();
+    while (len > 0) {
+        if (ctx->_bufpos >= EMBAJAX_OUTPUT_BUFFER_SIZE) commitBuffer(ctx);
+        size_t chunk = min(len, (size_t) (EMBAJAX_OUTPUT_BUFFER_SIZE - ctx->_bufpos));
+        memcpy_P(ctx->_buf + ctx->_bufpos, value, chunk);
+        ctx->_bufpos += chunk;
+        value += chunk;
+        len -= chunk;
     }
 }
+#endif
 
 #define handleOneChar() {                                           \
     if (c == JS_QUOTED_STRING_ARG[0]) {                             \
@@ -85,8 +319,7 @@ void EmbAJAXOutputDriverBase::_printContent(const char* value) {
         } else if (c == HTML_ESCAPED_STRING_ARG[0]) {               \
             _printFiltered(va_arg(args, char*), NotQuoted, true);   \
         } else if (c == INTEGER_VALUE_ARG[0]) {                     \
-            char buf[12];                                           \
-            _printContent(itoa(va_arg(args, int), buf, 10));        \
+            _printInteger(va_arg(args, int));                       \
         } else if (c == PLAIN_STRING_ARG[0]) {                      \
             _printContent(va_arg(args, char*));                     \
         } else {                                                    \
@@ -104,7 +337,6 @@ void EmbAJAXOutputDriverBase::_printContentF(const char* fmt, ...) {
         else handleOneChar();
     }
     va_end(args);
-    commitBuffer();
 }
 
 #if USE_PROGMEM_STRINGS
@@ -130,7 +362,37 @@ void EmbAJAXOutputDriverBase::_printContentF(const __FlashStringHelper* _fmt, ..
         else handleOneChar();
     }
     va_end(args);
-    commitBuffer();
+}
+#endif
+
+void EmbAJAXOutputDriverBase::_printSegmentsF(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    while(true) {
+        size_t len = va_arg(args, int);
+        _printStatic(fmt, len);
+        fmt += len;
+        const char c = *fmt++;
+        if (c == '\0') break;
+        else handleOneChar();
+    }
+    va_end(args);
+}
+
+#if USE_PROGMEM_STRINGS
+void EmbAJAXOutputDriverBase::_printSegmentsF(const __FlashStringHelper* _fmt, ...) {
+    va_list args;
+    va_start(args, _fmt);
+    PGM_P fmt = reinterpret_cast<PGM_P>(_fmt);
+    while(true) {
+        size_t len = va_arg(args, int);
+        _printStaticP(fmt, len);
+        fmt += len;
+        const char c = pgm_read_byte(fmt++);
+        if (c == '\0') break;
+        else handleOneChar();
+    }
+    va_end(args);
 }
 #endif
 
@@ -142,6 +404,585 @@ void EmbAJAXOutputDriverBase::printAttribute(const char* name, const int32_t val
     _printContentF(" " PLAIN_STRING_ARG "=" INTEGER_VALUE_ARG, name, value);
 }
 
+size_t EmbAJAXOutputDriverBase::getArgChunk(const char* name, size_t offset, char* buf, size_t buflen) {
+    if (!buflen) return 0;
+    // getArg() can only read from the start of the value. Read everything up to the end of the requested chunk into a scratch buffer.
+    size_t scratchlen = offset + buflen + 1;
+    if (scratchlen > EMBAJAX_MAX_ARG_SCRATCH) scratchlen = EMBAJAX_MAX_ARG_SCRATCH;
+    if (offset >= scratchlen - 1) scratchlen = 0;  // offset lies beyond what could be read
+    char* scratch = scratchlen ? (char*) malloc(scratchlen) : 0;
+    if (!scratch) {
+#if EMBAJAX_DEBUG > 0
+        Serial.print("getArgChunk(): Could not read beyond offset ");
+        Serial.println(offset);
+#endif
+        return 0;
+    }
+    size_t len = strlen(getArg(name, scratch, scratchlen));
+#if EMBAJAX_DEBUG > 0
+    if (len == scratchlen - 1 && scratchlen < offset + buflen + 1) Serial.println("getArgChunk(): Value truncated at EMBAJAX_MAX_ARG_SCRATCH");
+#endif
+    len = (len > offset) ? len - offset : 0;
+    memcpy(buf, scratch + offset, len);
+    free(scratch);
+    return len;
+}
+
+bool EmbAJAXRequestArgs::parse(const char* body, size_t len) {
+    _body = body;
+    _num = 0;
+    if (len > 0xFFFF) return false;  // offsets would not fit into the slices
+    size_t pos = 0;
+    while (pos < len && _num < MaxArgs) {
+        size_t end = pos;
+        size_t value = 0;
+        while (end < len && body[end] != '&') {
+            if (!value && body[end] == '=') value = end + 1;
+            ++end;
+        }
+        if (value) {
+            _args[_num].name = pos;
+            _args[_num].value = value;
+            _args[_num].end = end;
+            ++_num;
+        }
+        pos = end + 1;
+    }
+    return true;
+}
+
+static char hexDigit(char c) {
+    if (c >= 'a') return c - 'a' + 10;
+    if (c >= 'A') return c - 'A' + 10;
+    return c - '0';
+}
+
+size_t EmbAJAXRequestArgs::get(const char* name, size_t offset, char* buf, size_t buflen) const {
+    size_t namelen = strlen(name);
+    for (uint8_t i = 0; i < _num; ++i) {
+        if (_args[i].name + namelen + 1 != _args[i].value || strncmp(_body + _args[i].name, name, namelen) != 0) continue;
+
+        size_t len = 0;
+        for (size_t pos = _args[i].value; pos < _args[i].end && len < buflen; ++pos) {
+            char c = _body[pos];
+            if (c == '+') c = ' ';
+            else if (c == '%' && pos + 2 < _args[i].end) {
+                c = (hexDigit(_body[pos + 1]) << 4) | hexDigit(_body[pos + 2]);
+                pos += 2;
+            }
+            if (offset) --offset;
+            else buf[len++] = c;
+        }
+        return len;
+    }
+    return 0;
+}
+
+uint32_t EmbAJAXOutputDriverBase::readClientRevision(const char* argname, uint32_t token) {
+    char buf[36];
+    char* end;
+    uint32_t revision = clientRevision(token, strtoul(getArg(argname, buf, sizeof(buf)), &end, 10));
+    EmbAJAXOutputContext* ctx = context();
+    ctx->_bulk_from = EmbAJAXElementIndex::npos;
+    if (revision && *end == '.') {
+        uint32_t bulk_since = strtoul(end + 1, &end, 10);
+        if (*end == '.' && bulk_since <= revision) {
+            ctx->_bulk_since = bulk_since;
+            ctx->_bulk_from = strtoul(end + 1, 0, 10);
+        }
+    }
+    return revision;
+}
+
+uint32_t EmbAJAXOutputDriverBase::clientRevision(uint32_t token, uint32_t revision) {
+    lock();
+    uint32_t ret = revision;
+    if (revision > _revision) ret = 0;  // definitely not from this session
+    else if (token != 0) {              // else: client does not identify itself. Nothing more to check.
+        ret = 0;  // unknown client, but claiming to have seen some revision, already
+        for (uint8_t i = 0; i < EMBAJAX_MAX_CLIENTS; ++i) {
+            if (_clients[i].token == token) {
+                ret = (revision > _clients[i].revision) ? 0 : revision;
+                break;
+            }
+        }
+    }
+#if EMBAJAX_METRICS
+    if (!ret) ++_metrics.full_syncs;
+#endif
+    unlock();
+    return ret;
+}
+
+void EmbAJAXOutputDriverBase::setClientRevision(uint32_t token, uint32_t revision) {
+    if (token == 0) return;
+    lock();
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < EMBAJAX_MAX_CLIENTS; ++i) {
+        if (_clients[i].token == token) {
+            slot = i;
+            break;
+        }
+        if (_clients[i].last_seen < _clients[slot].last_seen) slot = i;  // otherwise, replace the least recently seen client
+    }
+    _clients[slot].token = token;
+    _clients[slot].revision = revision;
+    _clients[slot].last_seen = millis();
+    unlock();
+}
+
+uint8_t EmbAJAXOutputDriverBase::activeClients(uint32_t latency_ms) {
+    if (!latency_ms) latency_ms = activeLatency();
+    uint8_t ret = 0;
+    uint32_t now = millis();
+    lock();
+    for (uint8_t i = 0; i < EMBAJAX_MAX_CLIENTS; ++i) {
+        if (_clients[i].token && (now - _clients[i].last_seen < latency_ms)) ++ret;
+    }
+    unlock();
+    return ret;
+}
+
+void EmbAJAXMetrics::reset() {
+    memset(counters, 0, sizeof(counters));
+    full_syncs = 0;
+    _window_start = millis();
+}
+
+void EmbAJAXMetrics::record(uint8_t type, uint32_t time, uint32_t bytes, uint32_t calls, uint32_t now) {
+    if (type >= NumResponseTypes) return;
+    updateRates(now);
+    Counters &c = counters[type];
+    ++c.responses;
+    uint8_t bucket = 0;
+    while (bucket < NumBuckets - 1 && time >= bucketLimit(bucket)) ++bucket;
+    ++c.histogram[bucket];
+    c.time += time;
+    c.bytes += bytes;
+    c.calls += calls;
+    ++c.window;
+}
+
+void EmbAJAXMetrics::updateRates(uint32_t now) {
+    uint32_t elapsed = now - _window_start;
+    if (elapsed < 5000) return;
+    for (uint8_t i = 0; i < NumResponseTypes; ++i) {
+        counters[i].rate = (uint64_t) counters[i].window * 10000 / elapsed;
+        counters[i].window = 0;
+    }
+    _window_start = now;
+}
+
+#if EMBAJAX_METRICS
+/** Helper for printMetrics(): Print a single line "embajax_NAME{type="TYPE",le="LE"} VALUE". Type and le may be 0. */
+static void printMetric(EmbAJAXOutputDriverBase *driver, const char* name, const char* type, const char* le, uint64_t value, bool tenths = false) {
+    char buf[24];
+    char *pos = buf + sizeof(buf);
+    *(--pos) = '\0';
+    if (tenths) {
+        *(--pos) = '0' + value % 10;
+        *(--pos) = '.';
+        value /= 10;
+    }
+    do {
+        *(--pos) = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    driver->printContent("embajax_");
+    driver->printContent(name);
+    if (type) {
+        driver->printContent("{type=\"");
+        driver->printContent(type);
+        if (le) {
+            driver->printContent("\",le=\"");
+            driver->printContent(le);
+        }
+        driver->printContent("\"}");
+    }
+    driver->printContent(" ");
+    driver->printContent(pos);
+    driver->printContent("\n");
+}
+#endif
+
+void EmbAJAXOutputDriverBase::printMetrics() {
+    printHeader(false);
+#if EMBAJAX_METRICS
+    static const char* const types[EmbAJAXMetrics::NumResponseTypes] = { "page", "poll" };
+    lock();
+    _metrics.updateRates(millis());
+    EmbAJAXMetrics m = _metrics;  // NOTE: Copy, so the lock need not be held while printing
+    unlock();
+    for (uint8_t t = 0; t < EmbAJAXMetrics::NumResponseTypes; ++t) {
+        const EmbAJAXMetrics::Counters &c = m.counters[t];
+        printMetric(this, "responses_total", types[t], 0, c.responses);
+        printMetric(this, "responses_per_second", types[t], 0, c.rate, true);
+        uint32_t cumulative = 0;
+        for (uint8_t b = 0; b < EmbAJAXMetrics::NumBuckets; ++b) {
+            char le[12];
+            cumulative += c.histogram[b];
+            if (b < EmbAJAXMetrics::NumBuckets - 1) ultoa(EmbAJAXMetrics::bucketLimit(b), le, 10);
+            else strcpy(le, "+Inf");
+            printMetric(this, "response_time_us_bucket", types[t], le, cumulative);
+        }
+        printMetric(this, "response_time_us_sum", types[t], 0, c.time);
+        printMetric(this, "response_time_us_count", types[t], 0, c.responses);
+        printMetric(this, "response_bytes_total", types[t], 0, c.bytes);
+        printMetric(this, "print_calls_total", types[t], 0, c.calls);
+    }
+    printMetric(this, "full_syncs_total", 0, 0, m.full_syncs);
+    printMetric(this, "active_clients", 0, 0, activeClients());
+#else
+    printContent("# EMBAJAX_METRICS disabled\n");
+#endif
+    flush();
+}
+
+void EmbAJAXOutputDriverBase::addPolledPage(EmbAJAXPageBase* page) {
+    if (page->_poll_number) return;  // installed on several paths
+    page->_poll_number = _polled_pages ? _polled_pages->_poll_number + 1 : 1;
+    page->_next_polled = _polled_pages;
+    _polled_pages = page;
+}
+
+void EmbAJAXOutputDriverBase::handlePoll() {
+    beginResponse(EmbAJAXMetrics::Poll);
+    // One entry per page open on the client, see poll_script. At most as many as clients are kept track of, as each page tells its
+    // revision apart using its own token.
+    struct {
+        EmbAJAXPageBase* page;
+        uint32_t token;
+        uint32_t since;
+        uint32_t bulk_since;  // updates held back, see readClientRevision()
+        size_t bulk_from;
+    } polled[EMBAJAX_MAX_CLIENTS];
+    uint8_t num_polled = 0;
+    char conversion_buf[EMBAJAX_MAX_ID_LEN];
+    char pagearg[12] = "page";
+    char clientarg[12] = "client";
+    char revisionarg[12] = "revision";
+    for (uint8_t i = 0; i < EMBAJAX_MAX_CLIENTS; ++i) {
+        if (i > 0) {
+            itoa(i, pagearg + 4, 10);
+            itoa(i, clientarg + 6, 10);
+            itoa(i, revisionarg + 8, 10);
+        }
+        uint8_t number = atoi(getArg(pagearg, conversion_buf, EMBAJAX_MAX_ID_LEN));
+        if (!number) break;
+        EmbAJAXPageBase* page = _polled_pages;
+        while (page && page->_poll_number != number) page = page->_next_polled;
+        polled[num_polled].page = page;  // 0 if unknown (e.g. a firmware update with fewer pages): reply sends revision 0, only
+        polled[num_polled].token = strtoul(getArg(clientarg, conversion_buf, EMBAJAX_MAX_ID_LEN), 0, 10);
+        polled[num_polled].since = readClientRevision(revisionarg, polled[num_polled].token);
+        polled[num_polled].bulk_since = context()->_bulk_since;
+        polled[num_polled].bulk_from = context()->_bulk_from;
+        if (page) page->preparePoll();
+        ++num_polled;
+    }
+    lock();
+    nextRevision();
+    const uint32_t revision = _revision;
+    unlock();
+    for (uint8_t i = 0; i < num_polled; ++i) {
+        if (polled[i].page) setClientRevision(polled[i].token, revision);
+    }
+
+    // Same as replying to a poll of each page, in turn (see EmbAJAXBase::handleRequest()), with a separator line in between
+    for (uint8_t pass = precomputesContentLength() ? 0 : 1; pass < 2; ++pass) {
+        if (pass == 0) beginMeasuring();
+        else printHeader(false);
+        for (uint8_t i = 0; i < num_polled; ++i) {
+            if (i) printContent("#\n");
+            context()->_bulk_since = polled[i].bulk_since;
+            context()->_bulk_from = polled[i].bulk_from;
+            if (polled[i].page) polled[i].page->printPoll(polled[i].since, revision);
+            else printContent("0\n");
+        }
+        if (pass == 0) endMeasuring();
+    }
+    flush();
+    context()->_bulk_from = EmbAJAXElementIndex::npos;
+}
+
+void EmbAJAXOutputDriverBase::recordChange(EmbAJAXElement* element, uint32_t revision) {
+#if EMBAJAX_CHANGE_RING_SIZE > 0
+    // Several changes to the same element are usually merged into the same revision. Don't record those twice.
+    uint8_t pos = _changes_end;
+    for (uint8_t n = 0; n < _changes_count; ++n) {
+        pos = (pos + EMBAJAX_CHANGE_RING_SIZE - 1) % EMBAJAX_CHANGE_RING_SIZE;
+        if (_changes[pos].revision != revision) break;
+        if (_changes[pos].element == element) return;
+    }
+
+    if (_changes_count == EMBAJAX_CHANGE_RING_SIZE) {
+        // Overwriting the oldest record. Clients that have not seen that, yet, will need a full check of all elements.
+        uint32_t dropped = _changes[_changes_end].revision;
+        if (dropped > _changes_floor) _changes_floor = dropped;
+    } else {
+        ++_changes_count;
+    }
+    _changes[_changes_end].revision = revision;
+    _changes[_changes_end].element = element;
+    _changes_end = (_changes_end + 1) % EMBAJAX_CHANGE_RING_SIZE;
+#else
+    UNUSED(element);
+    UNUSED(revision);
+#endif
+}
+
+// The client side script. This is static, so it can be served as a separate (cacheable) resource, see installScript().
+#if USE_PROGMEM_STRINGS
+const char EmbAJAXOutputDriverBase::client_script[] PROGMEM =
+#else
+const char EmbAJAXOutputDriverBase::client_script[] =
+#endif
+    "var serverrevision = 0;\n"
+    "const client_token = Math.floor(Math.random() * 4294967295) + 1;\n"  // random identifier for this client, see EmbAJAXOutputDriverBase::clientRevision()
+    "var request_queue = [];\n"   // requests waiting to be sent
+    "const max_batch = " EMBAJAX_STRINGIFY(EMBAJAX_MAX_CHANGES_PER_REQUEST) ";\n"  // maximum number of queued requests to send at once
+    "const max_size = " EMBAJAX_STRINGIFY(EMBAJAX_MAX_REQUEST_SIZE) ";\n"  // ... and approximate maximum size of the request
+    // message types: 1: regular: request may be overridden by subsequent value changes on the same id - merge if in queue
+    //                2: semi-distinct: request may override type 1 requests for the same id, but will never be overridden (button clicks)
+    //                3: fully-distinct: request may not be merged with other requests of the same id at all
+    "function doRequest(id, value, mtype=1) {\n"
+    "    var req = {id: id, value: value, mtype: mtype};\n"
+    "    const i = request_queue.findIndex((x) => (x.id == id && x.mtype == 1));\n"
+    "    if (i >= 0 && (mtype < 3)) request_queue[i] = req;\n"
+    "    else request_queue.push(req);\n"
+    "    resetPolling();\n"
+    "    window.setTimeout(sendQueued, 0);\n"  // NOTE: often events will be generated twice (e.g. onInput+onChange). Wait for the second to come in, before sending
+    "}\n"
+
+    "var max_poll_interval = " EMBAJAX_STRINGIFY(EMBAJAX_MAX_POLL_INTERVAL) ";\n"  // may be changed by the server, see EmbAJAXOutputDriverBase::setMaxPollInterval()
+    "var poll_interval = 1000;\n"  // current interval between polls. Grows while nothing changes, see doUpdates()
+    "function resetPolling() {\n"
+    "    poll_interval = Math.min(1000, max_poll_interval);\n"
+    "}\n"
+    "var num_waiting = 0;\n"      // number of requests sent, with no reply received, yet
+    "var prev_request = 0;\n"
+    "var ws = null;\n"            // WebSocket connection, if available (see use_ws). Otherwise requests are sent via XMLHttpRequest
+    "var ws_body = '';\n"        // latest request sent via WebSocket
+    "var poked = false;\n"        // server has notified us of new changes
+    "function receiveReply(response) {\n"
+    "    doUpdates(response);\n"
+    "    if(window.ardujaxsh) window.ardujaxsh.in(poll_interval);\n"
+    "    --num_waiting;\n"
+    "}\n"
+    "function connectWS() {\n"
+    "    var s = new WebSocket(document.URL.split('#')[0].replace(/^http/, 'ws'));\n"
+    "    s.onopen = function() { ws = s; };\n"
+    "    s.onmessage = function(ev) {\n"
+    "       if (ev.data == 'p') { poked = true; window.setTimeout(sendQueued, 0); }\n"  // notification, only. The updates will be fetched by the reply to our next request
+    "       else if (ev.data == 'e') sendHTTP(document.URL, ws_body, receiveReply);\n"  // request too large for the server to take via WebSocket
+    "       else receiveReply(ev.data);\n"
+    "    };\n"
+    "    s.onclose = function() {\n"  // fall back to polling, and retry in a while
+    "       if (ws == s) {\n"
+    "          ws = null;\n"
+    "          if (num_waiting > 0) { serverrevision = 0; num_waiting = 0; }\n"
+    "       }\n"
+    "       window.setTimeout(connectWS, 5000);\n"
+    "    };\n"
+    "}\n"
+    "if (use_ws && window.WebSocket) connectWS();\n"
+    "function sendQueued() {\n"
+    "    var now = new Date().getTime();\n"
+    "    if (ws && num_waiting > 0 && (now - prev_request > 10000)) { serverrevision = 0; num_waiting = 0; }\n"  // reply lost?
+    "    if (num_waiting > 0 || (now - prev_request < min_interval)) return;\n"
+    "    if (!request_queue.length && (document.hidden || (!poked && (now - prev_request < poll_interval)))) return;\n"  //Nothing in queue, but last request more than poll_interval ms ago? Send a ping to query for updates. But not while hidden
+    "    poked = false;\n"
+    "    var body = '';\n"
+    "    for (var i = 0; i < max_batch && request_queue.length && (!i || body.length < max_size); ++i) {\n"
+    "       var q = request_queue.shift();\n"
+    "       var n = i ? i : '';\n"
+    "       body += 'id' + n + '=' + q.id + '&value' + n + '=' + encodeURIComponent(q.value) + '&';\n"
+    "    }\n"
+    "    ++num_waiting; prev_request = now;\n"
+    "    if (ws) {\n"
+    "       ws.send(ws_body = body + 'client=' + client_token + '&revision=' + serverrevision);\n"
+    "       return;\n"
+    "    }\n"
+    "    var url = document.URL, receive = receiveReply;\n"
+    "    if (!body && window.poll_page) [url, body, receive] = pollGroup();\n"  // nothing to send: poll along with other pages, see poll_script
+    "    sendHTTP(url, body + 'client=' + client_token + '&revision=' + serverrevision, receive);\n"
+    "}\n"
+    "function sendHTTP(url, body, receive) {\n"
+    "    var req = new XMLHttpRequest();\n"
+    "    req.timeout = 10000;\n"   // probably disconnected. Don't stack up request objects forever.
+    "    req.onload = function() {\n"
+    "       if (req.status == 200) receive(req.responseText);\n"
+    "       else req.onerror();\n"  // e.g. request too large (413)
+    "    }\n"
+    "    req.onerror = req.ontimeout = function() {\n" // if transmission failed, assume we are out of sync
+    "       serverrevision = 0;\n" // this will cause the server to re-send _all_ element states on the next poll()
+    "       --num_waiting;\n"
+    "    };\n"
+    "    req.open('POST', url, true);\n"
+    "    req.setRequestHeader('Content-type', 'application/octet-stream');\n"  // still url-encoded, but this way, the server keeps the body as a whole, see EmbAJAXRequestArgs
+    "    req.send(body);\n"
+    "}\n"
+    "window.setInterval(sendQueued, min_interval/2+1);\n"
+    "document.addEventListener('visibilitychange', function() { if (!document.hidden) { resetPolling(); sendQueued(); } });\n"
+
+    "const property_specs = property_names.map((p) => p.split('.'));\n"  // tables sent with the page, see EmbAJAXElement::sendUpdates()
+    "var element_cache = [];\n"
+    "var target_cache = {};\n"  // object and name of the property to set, per element and property (e.g. the style of an element, and 'display')
+    "var pending_updates = new Map();\n"  // updates to apply on the next animation frame, with only the latest value per element and property
+    "var num_unmerged = 0;\n"
+    "function queueUpdate(key, element, spec, value) {\n"
+    "    var t = target_cache[key];\n"
+    "    if (!t) {\n"
+    "       var obj = element;\n"
+    "       for(var k = 0; k < (spec.length-1); ++k) {\n"   // resolve nested attributes such as style.display
+    "           obj = obj[spec[k]];\n"
+    "       }\n"
+    "       t = target_cache[key] = [obj, spec[spec.length-1]];\n"
+    "    }\n"
+    "    if (t[1].startsWith('EmbAJAX')) key += '#' + (++num_unmerged);\n"  // scripted properties (e.g. of EmbAJAXTimeSeries) need to see every value
+    "    if (!pending_updates.size) {\n"
+    "       if (window.requestAnimationFrame) window.requestAnimationFrame(applyUpdates);\n"
+    "       else window.setTimeout(applyUpdates, 0);\n"
+    "    }\n"
+    "    pending_updates.set(key, [t, value]);\n"
+    "}\n"
+    "function applyUpdates() {\n"
+    "    var updates = pending_updates;\n"
+    "    pending_updates = new Map();\n"
+    "    updates.forEach((u) => { u[0][0][u[0][1]] = u[1]; });\n"
+    "}\n"
+    "function doUpdates(response) {\n"
+    "    var lines = response.split('\\n');\n"
+    "    var head = lines[0].split(',');\n"  // revision[,max_poll_interval]
+    "    serverrevision = head[0];\n"
+    "    if (head.length > 1) max_poll_interval = +head[1];\n"
+    "    if (lines.length > 2 || lines[1]) resetPolling();\n"
+    "    else poll_interval = Math.min(poll_interval * 2, max_poll_interval);\n"  // nothing changed: back off
+    "    for(var i = 1; i < lines.length; ++i) {\n"
+    "       var line = lines[i];\n"
+    "       if (!line) continue;\n"
+    "       if (line[0] == '!') {\n"  // some changes held back, see EmbAJAXOutputDriverBase::setUpdateBudget(). Sent back as part of the revision.
+    "          serverrevision = head[0] + '.' + line.substring(1);\n"
+    "       } else if (line[0] == '[') {\n"  // element or property not in the tables, sent by name
+    "          var change = JSON.parse(line);\n"
+    "          var key = '[' + change[0] + ':' + change[1];\n"
+    "          queueUpdate(key, target_cache[key] ? null : document.getElementById(change[0]), change[1].split('.'), change[2]);\n"
+    "       } else {\n"               // element:property:value
+    "          var a = line.indexOf(':');\n"
+    "          var b = line.indexOf(':', a+1);\n"
+    "          var e = line.substring(0, a);\n"
+    "          var p = line.substring(a+1, b);\n"
+    "          var value = line.substring(b+1);\n"
+    "          if (value.indexOf('\\\\') >= 0) value = value.replace(/\\\\(.)/g, (m, c) => (c == 'n' ? '\\n' : c));\n"
+    "          queueUpdate(line.substring(0, b), element_cache[e] || (element_cache[e] = document.getElementById(element_ids[e])), property_specs[p], value);\n"
+    "       }\n"
+#if EMBAJAX_DEBUG > 2
+    "       console.log('Received change at revision ' + serverrevision + ': ' + line);\n"
+#endif
+    "    }\n"
+    "}\n";
+
+// Shared poll of several pages open in the same browser, see EmbAJAXOutputDriverBase::setPollPath(). Appended to client_script, if enabled.
+// Each page announces its state to the others, once per second. Whichever page polls first, polls for all others that are idle,
+// and passes on their part of the reply.
+#if USE_PROGMEM_STRINGS
+const char EmbAJAXOutputDriverBase::poll_script[] PROGMEM =
+#else
+const char EmbAJAXOutputDriverBase::poll_script[] =
+#endif
+    "const max_poll_pages = " EMBAJAX_STRINGIFY(EMBAJAX_MAX_CLIENTS) ";\n"
+    "var poll_peers = new Map();\n"  // other pages: client token -> [page number, revision, time of announcement]
+    "var poll_channel = (window.poll_page && window.BroadcastChannel) ? new BroadcastChannel('EmbAJAX') : null;\n"
+    "function announcePoll() {\n"
+    "    var idle = !(num_waiting || request_queue.length || ws || document.hidden);\n"
+    "    poll_channel.postMessage(idle ? [client_token, poll_page, serverrevision] : [client_token]);\n"
+    "}\n"
+    "function pollGroup() {\n"  // see sendQueued(): url, body, and reply handler for a poll on behalf of all idle pages
+    "    var now = Date.now();\n"
+    "    var body = 'page=' + poll_page + '&';\n"
+    "    var peers = [];\n"
+    "    poll_peers.forEach((p, token) => {\n"
+    "       if (now - p[2] > 3000 || peers.length + 1 >= max_poll_pages) return;\n"  // not heard of in a while: closed, or stuck
+    "       var n = peers.length + 1;\n"
+    "       body += 'page' + n + '=' + p[0] + '&client' + n + '=' + token + '&revision' + n + '=' + p[1] + '&';\n"
+    "       peers.push([token, p[1]]);\n"
+    "    });\n"
+    "    return [poll_path, body, function(response) {\n"
+    "       var parts = response.split('\\n#\\n');\n"
+    "       receiveReply(parts[0]);\n"
+    "       if (peers.length) poll_channel.postMessage(peers.map((p, i) => [p[0], p[1], parts[i+1]]));\n"
+    "    }];\n"
+    "}\n"
+    "if (poll_channel) {\n"
+    "    poll_channel.onmessage = function(ev) {\n"
+    "       var m = ev.data;\n"
+    "       if (!Array.isArray(m[0])) {\n"  // announcement of another page
+    "          if (m.length > 1) poll_peers.set(m[0], [m[1], m[2], Date.now()]);\n"
+    "          else poll_peers.delete(m[0]);\n"
+    "          return;\n"
+    "       }\n"
+    "       var part = m.find((x) => x[0] == client_token);\n"  // reply to a poll on our behalf: [token, revision polled for, reply]
+    "       if (!part || num_waiting || parseInt(part[1]) > parseInt(serverrevision) || !(parseInt(part[2]) >= parseInt(serverrevision))) return;\n"  // could miss, or revert changes: poll ourselves
+    "       prev_request = Date.now();\n"
+    "       doUpdates(part[2]);\n"
+    "       if(window.ardujaxsh) window.ardujaxsh.in(poll_interval);\n"
+    "    };\n"
+    "    window.setInterval(announcePoll, 1000);\n"
+    "    document.addEventListener('visibilitychange', announcePoll);\n"
+    "    window.addEventListener('pagehide', () => poll_channel.postMessage([client_token]));\n"
+    "}\n";
+
+void EmbAJAXOutputDriverBase::printScript() {
+    size_t len = scriptLength();
+    size_t poll_len = _poll_path ? sizeof(poll_script) - 1 : 0;
+#if USE_PROGMEM_STRINGS
+    _printStaticP(client_script, len - poll_len);
+    if (poll_len) _printStaticP(poll_script, poll_len);
+#else
+    _printStatic(client_script, len - poll_len);
+    if (poll_len) _printStatic(poll_script, poll_len);
+#endif
+}
+
+/** FNV-1a over the given string, continuing from the given hash. @returns the length of the string */
+static size_t hashString(const char* str, uint32_t* hash) {
+    size_t len = 0;
+    while (true) {
+#if USE_PROGMEM_STRINGS
+        const char c = pgm_read_byte(str + len);
+#else
+        const char c = str[len];
+#endif
+        if (c == '\0') break;
+        *hash = (*hash ^ (uint8_t) c) * 16777619u;
+        ++len;
+    }
+    return len;
+}
+
+void EmbAJAXOutputDriverBase::hashScript() {
+    // FNV-1a. No need for anything fancy, we just want a new ETag, whenever the script changes
+    uint32_t hash = 2166136261u;
+    size_t len = hashString(client_script, &hash);
+    if (_poll_path) len += hashString(poll_script, &hash);
+    for (int i = 7; i >= 0; --i) {
+        _script_version[i] = hex_digits[hash & 0x0F];
+        hash >>= 4;
+    }
+    _script_version[8] = '\0';
+    _script_length = len;
+}
+
+const char* EmbAJAXOutputDriverBase::scriptVersion() {
+    if (!_script_length) hashScript();
+    return _script_version;
+}
+
+size_t EmbAJAXOutputDriverBase::scriptLength() {
+    if (!_script_length) hashScript();
+    return _script_length;
+}
+
 //////////////////////// EmbAJAXConnectionIndicator ///////////////////////
 
 void EmbAJAXConnectionIndicator::print() const {
@@ -150,7 +991,7 @@ void EmbAJAXConnectionIndicator::print() const {
                            "'good': 0,\n"
                            "'tid': null,\n"
                            "'toggle': function(on) { this.div.children[on].style.display = 'none'; this.div.children[1-on].style.display = 'inline'; this.good = on; },\n"
-                           "'in': function() { clearTimeout(this.tid); this.tid = window.setTimeout(this.toggle.bind(this, 0), 5000); if(!this.good) {this.toggle(1);} }\n"
+                           "'in': function(interval) { clearTimeout(this.tid); this.tid = window.setTimeout(this.toggle.bind(this, 0), Math.max(5000, (interval || 0) + 4000)); if(!this.good) {this.toggle(1);} }\n"
                            "};\nwindow.ardujaxsh.in();\n</script></div>");
 }
 
@@ -160,27 +1001,58 @@ void EmbAJAXConnectionIndicator::print() const {
 EmbAJAXElement::EmbAJAXElement(const char* id) : EmbAJAXBase() {
     _id = id;
     _flags = 1 << EmbAJAXBase::Visibility | 1 << EmbAJAXBase::Enabledness;
+    _publish_pending = false;
+    _echoed = false;
+    _publish_interval = 0;
+    _published = 0;
+    _priority = StatusPriority;
     revision = 1;
 }
 
-bool EmbAJAXElement::sendUpdates(uint16_t since, bool first) {
+bool EmbAJAXElement::sendUpdates(uint32_t since, bool first) {
+    UNUSED(first);
+    EmbAJAXOutputContext* ctx = _driver->context();
+    const EmbAJAXElementIndex* index = ctx->_update_index;
+    size_t pos = index ? index->position(this) : EmbAJAXElementIndex::npos;
+    // Updates held back from an earlier response apply from _bulk_from onwards, only. Before that, the client is up to date as usual.
+    if (_priority == BulkPriority && ctx->_bulk_from != EmbAJAXElementIndex::npos && (pos == EmbAJAXElementIndex::npos || pos < ctx->_bulk_from)) {
+        since = ctx->_update_since;
+    }
     if (!changed(since)) return false;
-    if (!first) _driver->printContent(",\n");
-    _driver->printFormatted("{\n\"id\": ", JS_QUOTED_STRING(_id), ",\n\"changes\": [");
+    if (ctx->_update_pass != 0xFF && ctx->_update_pass != _priority) return false;  // sent in another pass, see EmbAJAXBase::printUpdates()
+    if (_priority == BulkPriority && _driver->_update_budget && pos != EmbAJAXElementIndex::npos) {
+        if (ctx->_bulk_sent && (ctx->_emitted + ctx->_bufpos - ctx->_update_start) >= _driver->_update_budget) {
+            // Over budget. Sent in reply to the next request of this client, see EmbAJAXBase::printUpdates(). Other clients are not affected.
+            if (pos < ctx->_held_from) ctx->_held_from = pos;
+            return false;
+        }
+        ctx->_bulk_sent = true;
+    }
+    char buf[EMBAJAX_VALUE_BUFLEN];
     uint8_t i = 0;
     while (true) {
         const char* pid = valueProperty(i);
-        const char* pval = value(i);
+        const char* pval = formatValue(i, buf, EMBAJAX_VALUE_BUFLEN);
         if (!pid || !pval) break;
 
-        if (i != 0) _driver->printContent(",");
-        _driver->printFormatted("[", JS_QUOTED_STRING(pid), ", ");
-        _driver->printFiltered(pval, EmbAJAXOutputDriverBase::JSQuoted, valueNeedsEscaping(i));
-        _driver->printContent("]");
+        size_t prop = (pos != EmbAJAXElementIndex::npos) ? index->propertyNumber(pid) : EmbAJAXElementIndex::npos;
+        if (prop != EmbAJAXElementIndex::npos) {
+            _driver->printFormatted("", INTEGER_VALUE(pos), ":", INTEGER_VALUE(prop), ":");
+            if (printValue(i, since, EmbAJAXOutputDriverBase::JSEscaped)) {}
+            else if (valueIsPlain(i)) _driver->printPlain(pval, EmbAJAXOutputDriverBase::JSEscaped);
+            else _driver->printFiltered(pval, EmbAJAXOutputDriverBase::JSEscaped, valueNeedsEscaping(i));
+            _driver->printContent("\n");
+        } else {
+            // Not in the tables sent with the page (e.g. inside a custom container without child()). Send by name, instead.
+            _driver->printFormatted("[", JS_QUOTED_STRING(_id), ",", JS_QUOTED_STRING(pid), ",");
+            if (printValue(i, since, EmbAJAXOutputDriverBase::JSQuoted)) {}
+            else if (valueIsPlain(i)) _driver->printPlain(pval, EmbAJAXOutputDriverBase::JSQuoted);
+            else _driver->printFiltered(pval, EmbAJAXOutputDriverBase::JSQuoted, valueNeedsEscaping(i));
+            _driver->printContent("]\n");
+        }
 
         ++i;
     }
-    _driver->printContent("]\n}");
     return true;
 }
 
@@ -189,16 +1061,82 @@ void EmbAJAXElement::setBasicProperty(uint8_t num, bool status) {
     if (status == (bool) (_flags & status_bit)) return;
     if (status) _flags |= status_bit;
     else _flags -= _flags & status_bit;
-    setChanged();
+    if (num != EmbAJAXBase::Deferred) setChanged();  // Not a property of the element on the client
 }
 
 void EmbAJAXElement::setChanged() {
-    revision = _driver->setChanged();
+    if (!_publish_interval) {
+        publishChange();
+        return;
+    }
+    _driver->lock();
+    if ((uint16_t) (millis() - _published) < _publish_interval) {
+        // Too soon. Hold back until the next change, or the next request after the interval, see EmbAJAXBase::publishDeferred()
+        if (!_publish_pending) {
+            _publish_pending = true;
+            ++(_driver->_deferred_changes);
+        }
+    } else {
+        publishChange();
+    }
+    _driver->unlock();
+}
+
+void EmbAJAXElement::publishChange() {
+    _driver->lock();
+    _echoed = false;
+    if (_publish_pending) {
+        _publish_pending = false;
+        --(_driver->_deferred_changes);
+    }
+    if (_publish_interval) _published = millis();
+    uint32_t new_revision = _driver->setChanged();
+    if (revision != new_revision) {  // else: already recorded
+        revision = new_revision;
+        _driver->recordChange(this, revision);
+    }
+    _driver->unlock();
+}
+
+void EmbAJAXElement::publishIfDue() {
+    _driver->lock();
+    if (_publish_pending && ((uint16_t) (millis() - _published) >= _publish_interval)) publishChange();
+    _driver->unlock();
+}
+
+void EmbAJAXElement::setUpdatePriority(UpdatePriority priority) {
+    _priority = priority;
+    if (priority != StatusPriority) _driver->_priorities_used = true;
+}
+
+void EmbAJAXElement::setPublishInterval(uint16_t interval) {
+    _publish_interval = interval;
+    if (_publish_pending) publishChange();
 }
 
-bool EmbAJAXElement::changed(uint16_t since) {
-    if ((revision + 40000) < since) revision = since + 1;    // basic overflow protection. Results in sending _all_ states at least every 40000 request cycles
-    return (revision > since);
+uint32_t EmbAJAXElement::checksum(const char* value) {
+    // FNV-1a, like EmbAJAXOutputDriverBase::hashScript()
+    uint32_t hash = 2166136261u;
+    if (!value) return 0;
+    while (*value != '\0') {
+        hash = (hash ^ (uint8_t) *value) * 16777619u;
+        ++value;
+    }
+    return hash;
+}
+
+bool EmbAJAXElement::changed(uint32_t since) {
+    if (revision <= since) return false;
+    // Sent by the client of the current response, itself? See EmbAJAXBase::handleRequest()
+    const EmbAJAXOutputContext* ctx = _driver->context();
+    for (uint8_t i = 0; i < ctx->_num_echo; ++i) {
+        if (ctx->_echo_elements[i] != this) continue;
+        _driver->lock();
+        bool echo = _echoed && (revision == ctx->_echo_revisions[i]);
+        _driver->unlock();
+        return !echo;
+    }
+    return true;
 }
 
 void EmbAJAXElement::printTextInput(size_t SIZE, const char* _value) const {
@@ -215,7 +1153,7 @@ void EmbAJAXBase::printChildren(EmbAJAXBase** _children, size_t NUM) const {
     }
 }
 
-bool EmbAJAXBase::sendUpdates(EmbAJAXBase** _children, size_t NUM, uint16_t since, bool first) {
+bool EmbAJAXBase::sendUpdates(EmbAJAXBase** _children, size_t NUM, uint32_t since, bool first) {
     for (size_t i = 0; i < NUM; ++i) {
         bool sent = _children[i]->sendUpdates(since, first);
         if (sent) first = false;
@@ -223,6 +1161,73 @@ bool EmbAJAXBase::sendUpdates(EmbAJAXBase** _children, size_t NUM, uint16_t sinc
     return !first;
 }
 
+bool EmbAJAXBase::sendRecordedUpdates(EmbAJAXBase** _children, size_t NUM, const EmbAJAXElementIndex* index, uint32_t since) {
+#if EMBAJAX_CHANGE_RING_SIZE > 0
+    if (!index->isComplete()) return false;
+
+    // Collect the elements to send, first, as the record may be modified from another task while we are sending (see EMBAJAX_THREAD_SAFE)
+    EmbAJAXElement* pending[EMBAJAX_CHANGE_RING_SIZE];
+    uint8_t num_pending = 0;
+    _driver->lock();
+    if (since < _driver->_changes_floor) {
+        _driver->unlock();
+        return false;
+    }
+
+    // find the first change not yet seen by the client (going backwards from the latest change, so an idle poll is done, instantly)
+    uint8_t n = 0;
+    uint8_t pos = _driver->_changes_end;
+    while (n < _driver->_changes_count) {
+        uint8_t prev = (pos + EMBAJAX_CHANGE_RING_SIZE - 1) % EMBAJAX_CHANGE_RING_SIZE;
+        if (_driver->_changes[prev].revision <= since) break;
+        pos = prev;
+        ++n;
+    }
+
+    for (; n > 0; --n) {
+        const EmbAJAXOutputDriverBase::ChangeRecord &change = _driver->_changes[pos];
+        pos = (pos + 1) % EMBAJAX_CHANGE_RING_SIZE;
+        // Skip records that have been superseded by a later change of the same element
+        if (change.element->revision != change.revision) continue;
+        // Held back inside a hidden container. Let the container take note of this client's revision, see EmbAJAXHideableContainer::setDeferUpdates()
+        if (change.element->basicProperty(EmbAJAXBase::Deferred)) {
+            _driver->unlock();
+            return false;
+        }
+        pending[num_pending++] = change.element;
+    }
+    _driver->unlock();
+
+    bool first = true;
+    for (uint8_t i = 0; i < num_pending; ++i) {
+        EmbAJAXElement* element = pending[i];
+        // Skip elements not on this page. Elements that are not in the index may still be on this page, inside a container that
+        // does not implement child().
+        if (!index->contains(element) && findChild(_children, NUM, element->id()) != element) continue;
+        // Containers would also send their children, here, but we'll get to those as separate records, so send the element, only.
+        // Any other element may customize sendUpdates().
+        bool sent = element->numChildren() ? element->EmbAJAXElement::sendUpdates(since, first) : element->sendUpdates(since, first);
+        if (sent) first = false;
+    }
+    return true;
+#else
+    UNUSED(_children);
+    UNUSED(NUM);
+    UNUSED(index);
+    UNUSED(since);
+    return false;
+#endif
+}
+
+void EmbAJAXBase::republishChanged(const EmbAJAXBase* container, uint32_t since) {
+    for (size_t i = 0; i < container->numChildren(); ++i) {
+        EmbAJAXBase* child = container->child(i);
+        EmbAJAXElement* element = child->toElement();
+        if (element && element->changed(since)) element->publishChange();
+        republishChanged(child, since);
+    }
+}
+
 EmbAJAXElement* EmbAJAXBase::findChild(EmbAJAXBase** _children, size_t NUM, const char*id) const {
     for (size_t i = 0; i < NUM; ++i) {
         EmbAJAXElement* child = _children[i]->toElement();
@@ -235,6 +1240,128 @@ EmbAJAXElement* EmbAJAXBase::findChild(EmbAJAXBase** _children, size_t NUM, cons
     return 0;
 }
 
+//////////////////////// EmbAJAXElementIndex /////////////////////////////
+
+EmbAJAXElementIndex::~EmbAJAXElementIndex() {
+    free(_elements);
+    free(_properties);
+}
+
+size_t EmbAJAXElementIndex::collect(EmbAJAXBase* object, EmbAJAXElement** list, size_t pos) {
+    EmbAJAXElement* element = object->toElement();
+    if (element) {
+        if (list) list[pos] = element;
+        ++pos;
+    }
+    for (size_t i = 0; i < object->numChildren(); ++i) {
+        pos = collect(object->child(i), list, pos);
+    }
+    return pos;
+}
+
+void EmbAJAXElementIndex::build(EmbAJAXBase** children, size_t num) {
+    size_t count = 0;
+    for (size_t i = 0; i < num; ++i) count = collect(children[i], 0, count);
+    _elements = (EmbAJAXElement**) malloc(count * sizeof(EmbAJAXElement*));
+    if (!_elements && count) {  // Out of memory. Not fatal, as lookups will fall back to findChild()
+        _built = true;
+        return;
+    }
+
+    for (size_t i = 0; i < num; ++i) _count = collect(children[i], _elements, _count);
+
+    // Binary insertion sort. It is stable, so if there is more than one element of the same id, the first one (in
+    // document order) will be found, just like with findChild(). Also, it does not need any extra memory.
+    for (size_t i = 1; i < _count; ++i) {
+        EmbAJAXElement* element = _elements[i];
+        size_t lo = 0;
+        size_t hi = i;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (strcmp(element->id(), _elements[mid]->id()) < 0) hi = mid;
+            else lo = mid + 1;
+        }
+        memmove(&_elements[lo + 1], &_elements[lo], (i - lo) * sizeof(EmbAJAXElement*));
+        _elements[lo] = element;
+    }
+    _complete = true;
+    collectProperties();
+    _built = true;
+}
+
+void EmbAJAXElementIndex::collectProperties() {
+    // Most properties will be shared by many elements. Allocate for the worst case, first, then shrink to what is needed.
+    size_t count = 0;
+    for (size_t i = 0; i < _count; ++i) {
+        for (uint8_t which = 0; which < 255; ++which) {
+            if (_elements[i]->valueProperty(which) == 0) break;
+            ++count;
+        }
+    }
+    if (!count) return;
+    _properties = (const char**) malloc(count * sizeof(const char*));
+    if (!_properties) return;  // Out of memory. Not fatal, as properties will be sent by name.
+
+    for (size_t i = 0; i < _count; ++i) {
+        for (uint8_t which = 0; which < 255; ++which) {
+            const char* property = _elements[i]->valueProperty(which);
+            if (!property) break;
+            if (propertyNumber(property) == npos) _properties[_num_properties++] = property;
+        }
+    }
+    const char** shrunk = (const char**) realloc(_properties, _num_properties * sizeof(const char*));
+    if (shrunk) _properties = shrunk;
+}
+
+size_t EmbAJAXElementIndex::lowerBound(const char* id) const {
+    size_t lo = 0;
+    size_t hi = _count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (strcmp(_elements[mid]->id(), id) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+EmbAJAXElement* EmbAJAXElementIndex::find(const char* id) const {
+    size_t pos = lowerBound(id);
+    if (pos < _count && strcmp(_elements[pos]->id(), id) == 0) return _elements[pos];
+    return 0;
+}
+
+size_t EmbAJAXElementIndex::position(const EmbAJAXElement* element) const {
+    for (size_t pos = lowerBound(element->id()); pos < _count; ++pos) {
+        if (_elements[pos] == element) return pos;
+        if (strcmp(_elements[pos]->id(), element->id()) != 0) break;
+    }
+    return npos;
+}
+
+size_t EmbAJAXElementIndex::propertyNumber(const char* property) const {
+    // Properties are usually string literals, so try comparing pointers, first
+    for (size_t i = 0; i < _num_properties; ++i) {
+        if (_properties[i] == property) return i;
+    }
+    for (size_t i = 0; i < _num_properties; ++i) {
+        if (strcmp(_properties[i], property) == 0) return i;
+    }
+    return npos;
+}
+
+//////////////////////// EmbAJAXPageCache /////////////////////////////
+
+EmbAJAXPageCache::~EmbAJAXPageCache() {
+    free(_data);
+}
+
+void EmbAJAXPageCache::setEnabled(bool enabled) {
+    free(_data);
+    _data = 0;
+    _len = 0;
+    _enabled = enabled;
+}
+
 //////////////////////// EmbAJAXMutableSpan /////////////////////////////
 
 void EmbAJAXMutableSpan::print() const {
@@ -259,13 +1386,26 @@ const char* EmbAJAXMutableSpan::valueProperty(uint8_t which) const {
 }
 
 void EmbAJAXMutableSpan::setValue(const char* value, bool allowHTML) {
-    // TODO: Ideally we'd special case setValue() with old value == new value (noop). However, since often both old and new values are kept in the same char buffer,
-    // we cannot really compare the strings - without keeping a copy, at least. Should we?
+    // NOTE: Often both old and new values are kept in the same char buffer, so we cannot compare the strings, themselves. Optionally,
+    //       we compare checksums.
+    if (_skip_unchanged) {
+        uint32_t sum = checksum(value);
+        if (sum == _checksum && allowHTML == basicProperty(EmbAJAXBase::HTMLAllowed)) {
+            _value = value;  // The pointer may still have changed
+            return;
+        }
+        _checksum = sum;
+    }
     _value = value;
     setBasicProperty(EmbAJAXBase::HTMLAllowed, allowHTML);
     setChanged();
 }
 
+void EmbAJAXMutableSpan::setSkipUnchanged(bool skip) {
+    _skip_unchanged = skip;
+    _checksum = checksum(_value);
+}
+
 //////////////////////// EmbAJAXSlider /////////////////////////////
 
 EmbAJAXSlider::EmbAJAXSlider(const char* id, int16_t min, int16_t max, int16_t initial) : EmbAJAXElement(id) {
@@ -280,7 +1420,20 @@ void EmbAJAXSlider::print() const {
 }
 
 const char* EmbAJAXSlider::value(uint8_t which) const {
-    if (which == EmbAJAXBase::Value) return itoa(_value, itoa_buf, 10);
+    return formatValue(which, value_buf, EMBAJAX_VALUE_BUFLEN);
+}
+
+bool EmbAJAXSlider::valueIsPlain(uint8_t which) const {
+    if (which == EmbAJAXBase::Value) return true;
+    return EmbAJAXElement::valueIsPlain(which);
+}
+
+const char* EmbAJAXSlider::formatValue(uint8_t which, char* buf, size_t bufsize) const {
+    UNUSED(bufsize);
+    if (which == EmbAJAXBase::Value) {
+        formatInteger(_value, buf);
+        return buf;
+    }
     return EmbAJAXElement::value(which);
 }
 
@@ -296,6 +1449,7 @@ void EmbAJAXSlider::updateFromDriverArg(const char* argname) {
 }
 
 void EmbAJAXSlider::setValue(int16_t value) {
+    if (value == _value) return;
     _value = value;
     setChanged();
 }
@@ -309,33 +1463,42 @@ EmbAJAXColorPicker::EmbAJAXColorPicker(const char* id, uint8_t r, uint8_t g, uin
 }
 
 void EmbAJAXColorPicker::print() const {
-    _driver->printFormatted("<input type=\"color\" id=", HTML_QUOTED_STRING(_id), " value=", HTML_QUOTED_STRING(value()),
+    char buf[EMBAJAX_VALUE_BUFLEN];
+    _driver->printFormatted("<input type=\"color\" id=", HTML_QUOTED_STRING(_id), " value=", HTML_QUOTED_STRING(formatValue(EmbAJAXBase::Value, buf, EMBAJAX_VALUE_BUFLEN)),
                            " oninput=\"doRequest(this.id, this.value);\" onchange=\"oninput();\"/>");
 }
 
-// helper to make sure we get exactly two hex digits for any input
-char* color_itoa(uint8_t c, char* buf) {
-    itoa(c >> 4, buf, 16);
-    itoa(c & 0x0F, buf + sizeof(char), 16);
-    return buf;
+const char* EmbAJAXColorPicker::value(uint8_t which) const {
+    return formatValue(which, value_buf, EMBAJAX_VALUE_BUFLEN);
 }
 
-const char* EmbAJAXColorPicker::value(uint8_t which) const {
+bool EmbAJAXColorPicker::valueIsPlain(uint8_t which) const {
+    if (which == EmbAJAXBase::Value) return true;
+    return EmbAJAXElement::valueIsPlain(which);
+}
+
+const char* EmbAJAXColorPicker::formatValue(uint8_t which, char* buf, size_t bufsize) const {
+    UNUSED(bufsize);
     if (which != EmbAJAXBase::Value) return EmbAJAXElement::value(which);
 
-    itoa_buf[0] = '#';
-    color_itoa(_r, &itoa_buf[1]);
-    color_itoa(_g, &itoa_buf[3]);
-    color_itoa(_b, &itoa_buf[5]);
-    return itoa_buf;
+    // exactly two hex digits per component
+    const uint8_t components[3] = {_r, _g, _b};
+    buf[0] = '#';
+    for (uint8_t i = 0; i < 3; ++i) {
+        buf[1 + 2*i] = hex_digits[components[i] >> 4];
+        buf[2 + 2*i] = hex_digits[components[i] & 0x0F];
+    }
+    buf[7] = '\0';
+    return buf;
 }
 
 const char* EmbAJAXColorPicker::valueProperty(uint8_t which) const {
     if (which == EmbAJAXBase::Value) return "value";
-    return EmbAJAXElement::value(which);
+    return EmbAJAXElement::valueProperty(which);
 }
 
 void EmbAJAXColorPicker::setColor(uint8_t r, uint8_t g, uint8_t b) {
+    if (r == _r && g == _g && b == _b) return;
     _r = r;
     _g = g;
     _b = b;
@@ -478,6 +1641,11 @@ const char* EmbAJAXCheckButton::value(uint8_t which) const {
     return EmbAJAXElement::value(which);
 }
 
+bool EmbAJAXCheckButton::valueIsPlain(uint8_t which) const {
+    if (which == EmbAJAXBase::Value) return true;
+    return EmbAJAXElement::valueIsPlain(which);
+}
+
 void EmbAJAXCheckButton::updateFromDriverArg(const char* argname) {
     char buf[16];
     _driver->getArg(argname, buf, 16);
@@ -509,6 +1677,7 @@ void EmbAJAXOptionSelectBase::print(const char* const* _labels, uint8_t NUM) con
 }
 
 void EmbAJAXOptionSelectBase::selectOption(uint8_t num) {
+    if (num == _current_option) return;
     _current_option = num;
     setChanged();
 }
@@ -518,7 +1687,20 @@ uint8_t EmbAJAXOptionSelectBase::selectedOption() const {
 }
 
 const char* EmbAJAXOptionSelectBase::value(uint8_t which) const {
-    if (which == EmbAJAXBase::Value) return (itoa(_current_option, itoa_buf, 10));
+    return formatValue(which, value_buf, EMBAJAX_VALUE_BUFLEN);
+}
+
+bool EmbAJAXOptionSelectBase::valueIsPlain(uint8_t which) const {
+    if (which == EmbAJAXBase::Value) return true;
+    return EmbAJAXElement::valueIsPlain(which);
+}
+
+const char* EmbAJAXOptionSelectBase::formatValue(uint8_t which, char* buf, size_t bufsize) const {
+    UNUSED(bufsize);
+    if (which == EmbAJAXBase::Value) {
+        formatInteger(_current_option, buf);
+        return buf;
+    }
     return EmbAJAXElement::value(which);
 }
 
@@ -528,78 +1710,308 @@ const char* EmbAJAXOptionSelectBase::valueProperty(uint8_t which) const {
 }
 
 void EmbAJAXOptionSelectBase::updateFromDriverArg(const char* argname) {
-    _current_option = atoi(_driver->getArg(argname, itoa_buf, ITOA_BUFLEN));
+    char buf[EMBAJAX_VALUE_BUFLEN];
+    _current_option = atoi(_driver->getArg(argname, buf, EMBAJAX_VALUE_BUFLEN));
+}
+
+//////////////////////// EmbAJAXControlTable ///////////////////////
+
+EmbAJAXControlTableBase::EmbAJAXControlTableBase(const char* id, const EmbAJAXControlTableRow* rows, size_t num, int16_t* values, uint32_t* revisions, uint8_t* echoed) : EmbAJAXElement(id) {
+    _rows = rows;
+    _num = num;
+    _values = values;
+    _revisions = revisions;
+    _echoed_rows = echoed;
+    for (size_t i = 0; i < num; ++i) {
+        memcpy_P(&_values[i], &rows[i].initial, sizeof(int16_t));
+        _revisions[i] = 1;  // like any element, see EmbAJAXElement::EmbAJAXElement()
+    }
+    memset(_echoed_rows, 0, (num + 7) / 8);
+}
+
+size_t EmbAJAXControlTableBase::rowNumber(const char* id) const {
+    size_t len = strlen(_id);
+    if (strncmp(id, _id, len) != 0) return NoRow;
+    const char* digits = id + len;
+    if (!isdigit(digits[0]) || (digits[0] == '0' && digits[1] != '\0')) return NoRow;
+    size_t row = 0;
+    for (; *digits; ++digits) {
+        if (!isdigit(*digits)) return NoRow;
+        row = row * 10 + (*digits - '0');
+        if (row >= _num) return NoRow;
+    }
+    return row;
+}
+
+void EmbAJAXControlTableBase::rowId(size_t row, char* buf) const {
+    size_t len = strlen(_id);
+    if (len > EMBAJAX_MAX_ID_LEN - 6) len = EMBAJAX_MAX_ID_LEN - 6;  // too long, anyway
+    memcpy(buf, _id, len);
+    ultoa(row, buf + len, 10);
+}
+
+EmbAJAXElement* EmbAJAXControlTableBase::findChild(const char* id) const {
+    // The rows are not elements, but are handled by the table, see updateFromDriverArg()
+    return rowNumber(id) != NoRow ? const_cast<EmbAJAXControlTableBase*>(this) : 0;
+}
+
+void EmbAJAXControlTableBase::print() const {
+    char id[EMBAJAX_MAX_ID_LEN];
+    EmbAJAXControlTableRow row;
+    _driver->printFormatted("<div id=", HTML_QUOTED_STRING(_id), ">\n");
+    for (size_t i = 0; i < _num; ++i) {
+        memcpy_P(&row, &_rows[i], sizeof(row));
+        row.label[EMBAJAX_TABLE_LABEL_LEN - 1] = '\0';
+        rowId(i, id);
+        // Same markup as EmbAJAXSlider, EmbAJAXCheckButton, and EmbAJAXMutableSpan, so the client handles rows like those
+        if (row.type == EmbAJAXControlTableRow::CheckBox) {
+            _driver->printFormatted("<div><span class=\"checkbox\"><input id=", HTML_QUOTED_STRING(id), " type=\"checkbox\" value=\"t\" onChange=\"doRequest(this.id, this.checked ? 't' : 'f');\"");
+            if (_values[i]) _driver->printContent(" checked=\"true\"");
+            _driver->printFormatted("/><label for=", HTML_QUOTED_STRING(id), ">", PLAIN_STRING(row.label), "</label></span></div>\n");
+            continue;
+        }
+        _driver->printFormatted("<div><label for=", HTML_QUOTED_STRING(id), ">", PLAIN_STRING(row.label), "</label> ");
+        if (row.type == EmbAJAXControlTableRow::Slider) {
+            _driver->printFormatted("<input type=\"range\" id=", HTML_QUOTED_STRING(id), " min=", INTEGER_VALUE(row.min), " max=", INTEGER_VALUE(row.max), " value=", INTEGER_VALUE(_values[i]),
+                                   " oninput=\"doRequest(this.id, this.value);\" onchange=\"oninput();\"/>");
+        } else {
+            _driver->printFormatted("<span id=", HTML_QUOTED_STRING(id), ">", INTEGER_VALUE(_values[i]), "</span>");
+        }
+        _driver->printContent("</div>\n");
+    }
+    _driver->printContent("</div>");
+}
+
+bool EmbAJAXControlTableBase::sendUpdates(uint32_t since, bool first) {
+    bool sent = EmbAJAXElement::sendUpdates(since, first);  // visibility and enabledness of the table, itself
+    const EmbAJAXOutputContext* ctx = _driver->context();
+    if (ctx->_update_pass != 0xFF && ctx->_update_pass != _priority) return sent;  // sent in another pass, see EmbAJAXBase::printUpdates()
+
+    // Rows changed by the request being answered are not echoed back to it (see EmbAJAXBase::handleRequest()), unless changed again, since.
+    // The echo records of the response only tell that some row of this table has been received, so look up which, in the request.
+    size_t received[EMBAJAX_MAX_CHANGES_PER_REQUEST];
+    uint8_t num_received = 0;
+    for (uint8_t i = 0; i < ctx->_num_echo; ++i) {
+        if (ctx->_echo_elements[i] != this) continue;
+        char idarg[12] = "id";
+        char id[EMBAJAX_MAX_ID_LEN];
+        for (uint8_t j = 0; j < EMBAJAX_MAX_CHANGES_PER_REQUEST; ++j) {
+            if (j > 0) itoa(j, idarg + 2, 10);
+            if (_driver->getArg(idarg, id, EMBAJAX_MAX_ID_LEN)[0] == '\0') break;
+            size_t row = rowNumber(id);
+            if (row != NoRow) received[num_received++] = row;
+        }
+        break;
+    }
+
+    char id[EMBAJAX_MAX_ID_LEN];
+    char buf[EMBAJAX_VALUE_BUFLEN];
+    for (size_t i = 0; i < _num; ++i) {
+        _driver->lock();
+        bool changed = _revisions[i] > since;
+        if (changed && (_echoed_rows[i / 8] & (1 << (i % 8)))) {
+            for (uint8_t j = 0; j < num_received; ++j) {
+                if (received[j] == i) changed = false;
+            }
+        }
+        int16_t value = _values[i];
+        _driver->unlock();
+        if (!changed) continue;
+
+        uint8_t type = rowType(i);
+        rowId(i, id);
+        const char* pid = (type == EmbAJAXControlTableRow::Slider) ? "value" : "innerHTML";
+        const char* pval = buf;
+        if (type == EmbAJAXControlTableRow::CheckBox) {
+            pid = "checked";
+            pval = value ? "true" : "";
+        } else {
+            formatInteger(value, buf);
+        }
+        // Not in the tables sent with the page, see EmbAJAXElement::sendUpdates()
+        _driver->printFormatted("[", JS_QUOTED_STRING(id), ",", JS_QUOTED_STRING(pid), ",");
+        _driver->printPlain(pval, EmbAJAXOutputDriverBase::JSQuoted);
+        _driver->printContent("]\n");
+        sent = true;
+    }
+    return sent;
+}
+
+void EmbAJAXControlTableBase::updateFromDriverArg(const char* argname) {
+    // argname is "value<n>", see EmbAJAXBase::handleRequest(). The row is identified by the matching "id<n>".
+    char idarg[12] = "id";
+    strncpy(idarg + 2, argname + 5, sizeof(idarg) - 3);
+    char id[EMBAJAX_MAX_ID_LEN];
+    size_t row = rowNumber(_driver->getArg(idarg, id, EMBAJAX_MAX_ID_LEN));
+    if (row == NoRow) return;
+    uint8_t type = rowType(row);
+    if (type == EmbAJAXControlTableRow::Readout) return;  // not an input
+
+    char buf[16];
+    _driver->getArg(argname, buf, 16);
+    _driver->lock();
+    _values[row] = (type == EmbAJAXControlTableRow::CheckBox) ? (buf[0] == 't') : atoi(buf);
+    _revisions[row] = _driver->setChanged();
+    _echoed_rows[row / 8] |= 1 << (row % 8);
+    _driver->unlock();
+}
+
+void EmbAJAXControlTableBase::setRowValue(size_t row, int16_t value) {
+    if (row >= _num) return;
+    _driver->lock();
+    bool changed = _values[row] != value;
+    if (changed) {
+        _values[row] = value;
+        _revisions[row] = _driver->setChanged();
+        _echoed_rows[row / 8] &= ~(1 << (row % 8));
+    }
+    _driver->unlock();
+    if (changed) publishChange();
+}
+
+void EmbAJAXControlTableBase::setBasicProperty(uint8_t num, bool status) {
+    if (num == EmbAJAXBase::Deferred && !status && basicProperty(EmbAJAXBase::Deferred)) {
+        // Shown again, after changes have been held back (see EmbAJAXHideableContainer::setDeferUpdates()). The revisions of those are
+        // not known, here, so send all rows.
+        EmbAJAXElement::setBasicProperty(num, status);
+        _driver->lock();
+        uint32_t revision = _driver->setChanged();
+        for (size_t i = 0; i < _num; ++i) _revisions[i] = revision;
+        memset(_echoed_rows, 0, (_num + 7) / 8);
+        _driver->unlock();
+        publishChange();
+        return;
+    }
+    EmbAJAXElement::setBasicProperty(num, status);
 }
 
 //////////////////////// EmbAJAXPage /////////////////////////////
 
-void EmbAJAXBase::printPage(EmbAJAXBase** _children, size_t NUM, const char* _title, const char* _header_add, uint16_t _min_interval) const {
+void EmbAJAXBase::publishDeferred(const EmbAJAXElementIndex* index) {
+    // NOTE: Elements missing from the index (see EmbAJAXElementIndex) will be published on their next change, only.
+    for (size_t i = 0; i < index->_count; ++i) index->_elements[i]->publishIfDue();
+}
+
+void EmbAJAXBase::buildIndex(EmbAJAXBase** _children, size_t NUM, EmbAJAXElementIndex* index) const {
+    if (index->isBuilt()) return;
+    // The first two requests to a page could be handled concurrently (see EmbAJAXOutputDriverBase::setContext()). Only one of them builds
+    // the index, the other waits for that.
+    _driver->lock();
+    bool claimed = !index->_building;
+    index->_building = true;
+    _driver->unlock();
+    if (claimed) index->build(_children, NUM);
+    else while (!index->isBuilt()) delay(1);
+}
+
+void EmbAJAXBase::printPage(EmbAJAXBase** _children, size_t NUM, const char* _title, const char* _header_add, uint16_t _min_interval, uint8_t _poll_number, EmbAJAXElementIndex* index, EmbAJAXPageCache* cache) const {
 #if EMBAJAX_DEBUG > 2
     time_t start = millis();
 #endif
+    _driver->beginResponse(EmbAJAXMetrics::PageLoad);
+    buildIndex(_children, NUM, index);
+    // Only one response at a time may use the cache. Any concurrent page loads (see EmbAJAXOutputDriverBase::setContext()) are rendered the regular way.
+    _driver->lock();
+    bool use_cache = cache->_enabled && !cache->_busy;
+    if (use_cache) cache->_busy = true;
+    _driver->unlock();
+    if (use_cache) {
+        if (cache->_data && cache->_structure_revision != _driver->structureRevision()) cache->setEnabled(true);  // outdated: discard
+        if (!cache->_data) {
+            cache->_structure_revision = _driver->structureRevision();
+            _driver->beginMeasuring();
+            printPageContents(_children, NUM, _title, _header_add, _min_interval, _poll_number, index);
+            _driver->endMeasuring();
+            cache->_len = _driver->contentLength();
+#if defined(ESP32) && defined(BOARD_HAS_PSRAM)
+            cache->_data = (char*) ps_malloc(cache->_len);
+            if (!cache->_data)
+#endif
+            cache->_data = (char*) malloc(cache->_len);
+            if (cache->_data) {
+                _driver->beginMeasuring(cache->_data, cache->_len);
+                printPageContents(_children, NUM, _title, _header_add, _min_interval, _poll_number, index);
+                _driver->endMeasuring();
+                if (_driver->contentLength() != cache->_len) cache->setEnabled(true);  // should not happen, but don't send garbage
+            }
+        }
+        const bool cached = cache->_data;
+        if (cached) _driver->printResponse(true, cache->_data, cache->_len);
+        _driver->lock();
+        cache->_busy = false;
+        _driver->unlock();
+        if (cached) return;
+        // else: out of memory. Print the page the regular way.
+    }
+    if (_driver->precomputesContentLength()) {
+        _driver->beginMeasuring();
+        printPageContents(_children, NUM, _title, _header_add, _min_interval, _poll_number, index);
+        _driver->endMeasuring();
+    }
     _driver->printHeader(true);
-    _driver->printFormatted("<!DOCTYPE html>\n<HTML><HEAD><TITLE>", PLAIN_STRING(_title), "</TITLE>\n<SCRIPT>\n"
-
-                            "var serverrevision = 0;\n"
-                            "var request_queue = [];\n"   // requests waiting to be sent
-                            // message types: 1: regular: request may be overridden by subsequent value changes on the same id - merge if in queue
-                            //                2: semi-distinct: request may override type 1 requests for the same id, but will never be overridden (button clicks)
-                            //                3: fully-distinct: request may not be merged with other requests of the same id at all
-                            "function doRequest(id, value, mtype=1) {\n"
-                            "    var req = {id: id, value: value, mtype: mtype};\n"
-                            "    const i = request_queue.findIndex((x) => (x.id == id && x.mtype == 1));\n"
-                            "    if (i >= 0 && (mtype < 3)) request_queue[i] = req;\n"
-                            "    else request_queue.push(req);\n"
-                            "    window.setTimeout(sendQueued, 0);\n"  // NOTE: often events will be generated twice (e.g. onInput+onChange). Wait for the second to come in, before sending
-                            "}\n"
-
-                            "var num_waiting = 0;\n"      // number of requests sent, with no reply received, yet
-                            "var prev_request = 0;\n"
-                            "function sendQueued() {\n"
-                            "    var now = new Date().getTime();\n"
-                            "    if (num_waiting > 0 || (now - prev_request < ", INTEGER_VALUE(_min_interval), ")) return;\n"
-                            "    var e = request_queue.shift();\n"
-                            "    if (!e && (now - prev_request < 1000)) return;\n"
-                            "    if (!e) e = {id: '', value: ''};\n" //Nothing in queue, but last request more than 1000 ms ago? Send a ping to query for updates
-                            "    var req = new XMLHttpRequest();\n"
-                            "    req.timeout = 10000;\n"   // probably disconnected. Don't stack up request objects forever.
-                            "    req.onload = function() {\n"
-                            "       doUpdates(JSON.parse(req.responseText));\n"
-                            "       if(window.ardujaxsh) window.ardujaxsh.in();\n"
-                            "       --num_waiting;\n"
-                            "    }\n"
-                            "    req.onerror = req.ontimeout = function() {\n" // if transmission failed, assume we are out of sync
-                            "       serverrevision = 0;\n" // this will cause the server to re-send _all_ element states on the next poll()
-                            "       --num_waiting;\n"
-                            "    };\n"
-                            "    ++num_waiting; prev_request = now;\n"
-                            "    req.open('POST', document.URL, true);\n"
-                            "    req.setRequestHeader('Content-type', 'application/x-www-form-urlencoded');\n"
-                            "    req.send('id=' + e.id + '&value=' + encodeURIComponent(e.value) + '&revision=' + serverrevision);\n"
-                            "}\n"
-                            "window.setInterval(sendQueued, ", INTEGER_VALUE(_min_interval/2+1), ");\n"
-
-                            "function doUpdates(response) {\n"
-                            "    serverrevision = response.revision;\n"
-                            "    var updates = response.updates;\n"
-                            "    for(i = 0; i < updates.length; i++) {\n"
-                            "       element = document.getElementById(updates[i].id);\n"
-                            "       changes = updates[i].changes;\n"
-                            "       for(j = 0; j < changes.length; ++j) {\n"
-                            "          var spec = changes[j][0].split('.');\n"
-                            "          var prop = element;\n"
+    printPageContents(_children, NUM, _title, _header_add, _min_interval, _poll_number, index);
+    _driver->flush();
 #if EMBAJAX_DEBUG > 2
-                            "          console.log('Received change at revision ' + serverrevision + ': ' + updates[i].id + '/' + spec + '=' + changes[j][1]);\n"
+    auto diff = millis() - start;
+    Serial.print("Page rendered in ");
+    Serial.print(diff);
+    Serial.println("ms");
 #endif
-                            "          for(k = 0; k < (spec.length-1); ++k) {\n"   // resolve nested attributes such as style.display
-                            "              prop = prop[spec[k]];\n"
-                            "          }\n"
-                            "          prop[spec[spec.length-1]] = changes[j][1];\n"
-                            "       }\n"
-                            "    }\n"
-                            "}\n"
-
-                            "</SCRIPT>\n", PLAIN_STRING(_header_add),
+}
+
+uint32_t EmbAJAXBase::layoutVersion(EmbAJAXBase** _children, size_t NUM, const char* _title, const char* _header_add, uint16_t _min_interval, uint8_t _poll_number, EmbAJAXElementIndex* index, EmbAJAXPageCache* cache) const {
+    _driver->lock();
+    uint16_t structure_revision = _driver->structureRevision();
+    uint32_t version = (cache->_version_structure_revision == structure_revision) ? cache->_version : 0;
+    _driver->unlock();
+    if (version) return version;
+
+    // Render the page to a hash, only. The current values of the elements are part of that, but this is done only once per structure
+    // revision, so they need not stay current: The first request of each client after loading the page syncs all values, anyway.
+    buildIndex(_children, NUM, index);
+    EmbAJAXOutputContext* ctx = _driver->context();
+    _driver->beginMeasuring();
+    ctx->_hashing = true;
+    ctx->_hash = 2166136261u;
+    printPageContents(_children, NUM, _title, _header_add, _min_interval, _poll_number, index);
+    _driver->endMeasuring();
+    ctx->_hashing = false;
+    version = ctx->_hash ? ctx->_hash : 1;
+
+    _driver->lock();
+    cache->_version = version;
+    cache->_version_structure_revision = structure_revision;
+    _driver->unlock();
+    return version;
+}
+
+void EmbAJAXBase::printPageContents(EmbAJAXBase** _children, size_t NUM, const char* _title, const char* _header_add, uint16_t _min_interval, uint8_t _poll_number, const EmbAJAXElementIndex* index) const {
+    _driver->printFormatted("<!DOCTYPE html>\n<HTML><HEAD><TITLE>", PLAIN_STRING(_title), "</TITLE>\n<SCRIPT>\n"
+                            "var min_interval = ", INTEGER_VALUE(_min_interval), ";\n"
+                            "var use_ws = ", INTEGER_VALUE(_driver->hasPushTransport()), ";\n"
+                            "var element_ids = [");
+    // Tables for decoding updates, see EmbAJAXElement::sendUpdates()
+    for (size_t i = 0; i < index->_count; ++i) {
+        if (i) _driver->printContent(",");
+        _driver->printJSQuoted(index->_elements[i]->id());
+    }
+    _driver->printContent("];\nvar property_names = [");
+    for (size_t i = 0; i < index->_num_properties; ++i) {
+        if (i) _driver->printContent(",");
+        _driver->printJSQuoted(index->_properties[i]);
+    }
+    _driver->printContent("];\n");
+    if (_poll_number && _driver->pollPath()) {
+        _driver->printFormatted("var poll_page = ", INTEGER_VALUE(_poll_number), ";\n"
+                                "var poll_path = ", JS_QUOTED_STRING(_driver->pollPath()), ";\n");
+    }
+    if (_driver->scriptPath()) {
+        _driver->printFormatted("</SCRIPT>\n<SCRIPT src=\"", PLAIN_STRING(_driver->scriptPath()), "?v=", PLAIN_STRING(_driver->scriptVersion()), "\"></SCRIPT>\n");
+    } else {
+        _driver->printScript();
+        _driver->printContent("</SCRIPT>\n");
+    }
+    _driver->printFormatted("", PLAIN_STRING(_header_add),
                             "</HEAD>\n<BODY><FORM autocomplete=\"off\" onSubmit=\"return false;\">\n");
                             // NOTE: The nasty thing about autocomplete is that it does not trigger onChange() functions, but also the
                             // "restore latest settings after client reload" is questionable in our use-case.
@@ -607,28 +2019,98 @@ void EmbAJAXBase::printPage(EmbAJAXBase** _children, size_t NUM, const char* _ti
     printChildren(_children, NUM);
 
     _driver->printContent("\n</FORM></BODY></HTML>\n");
-#if EMBAJAX_DEBUG > 2
-    auto diff = millis() - start;
-    Serial.print("Page rendered in ");
-    Serial.print(diff);
-    Serial.println("ms");
-#endif
 }
 
-void EmbAJAXBase::handleRequest(EmbAJAXBase** _children, size_t NUM, void (*change_callback)()) {
+void EmbAJAXBase::handleBinary(EmbAJAXBase** _children, size_t NUM, EmbAJAXElementIndex* index, const uint8_t* data, size_t len, void (*change_callback)()) {
+    if (len < 2) return;
+    buildIndex(_children, NUM, index);
+    size_t pos = data[0] | (data[1] << 8);
+    if (pos >= index->_count) return;
+    EmbAJAXElement *element = index->_elements[pos];
+    if (!element->updateFromBinary(data + 2, len - 2)) return;
+    // NOTE: There is no reply to tell the client which revision this change has been handled at, so unlike in handleRequest(), the change
+    //       will be synced back to the sending client, too. Elements sending binary samples will typically want to ignore that, while busy.
+    _driver->lock();
+    element->publishChange();
+    _driver->unlock();
+    if (change_callback) change_callback();
+}
+
+void EmbAJAXBase::preparePoll(EmbAJAXBase** _children, size_t NUM, EmbAJAXElementIndex* index) {
+    buildIndex(_children, NUM, index);
+    if (_driver->_deferred_changes) publishDeferred(index);
+}
+
+void EmbAJAXBase::printUpdates(EmbAJAXBase** _children, size_t NUM, const EmbAJAXElementIndex* index, uint32_t since, uint32_t revision) {
+    // Response format: The revision on the first line (followed by ",<max poll interval>", if set, see setMaxPollInterval()), followed by one line per changed property, see EmbAJAXElement::sendUpdates(),
+    // and possibly a line "!<revision>.<position>" for updates held back, see below.
+    char buf[12];
+    _driver->printContent(ultoa(revision, buf, 10));
+    if (_driver->_announce_poll_interval) {
+        _driver->printContent(",");
+        _driver->printInteger(_driver->_max_poll_interval);
+    }
+    _driver->printContent("\n");
+    EmbAJAXOutputContext* context = _driver->context();
+    context->_update_index = index;
+    context->_update_start = context->_emitted + context->_bufpos;
+    context->_bulk_sent = false;
+    context->_update_since = since;
+    context->_held_from = EmbAJAXElementIndex::npos;
+    if (!_driver->_priorities_used) {
+        if (!sendRecordedUpdates(_children, NUM, index, since)) sendUpdates(_children, NUM, since, true);
+    } else {
+        // One pass per priority class, see EmbAJAXElement::setUpdatePriority()
+        for (uint8_t pass = 0; pass < EmbAJAXElement::NumUpdatePriorities; ++pass) {
+            context->_update_pass = pass;
+            if (pass == EmbAJAXElement::BulkPriority && context->_bulk_from != EmbAJAXElementIndex::npos) {
+                // Catching up on updates held back: Go by position (rather than by recorded change), so each response makes some progress
+                sendUpdates(_children, NUM, context->_bulk_since, true);
+            } else if (!sendRecordedUpdates(_children, NUM, index, since)) {
+                sendUpdates(_children, NUM, since, true);
+            }
+        }
+        context->_update_pass = 0xFF;
+    }
+    context->_update_index = 0;
+    // Updates held back due to setUpdateBudget(): Tell the client that it has been sent the changes to bulk elements from the first one held back
+    // onwards only up to the revision it had before. It sends this back in its next request, see EmbAJAXOutputDriverBase::readClientRevision().
+    if (context->_held_from != EmbAJAXElementIndex::npos) {
+        _driver->printContent("!");
+        _driver->printContent(ultoa(context->_bulk_from != EmbAJAXElementIndex::npos ? context->_bulk_since : since, buf, 10));
+        _driver->printContent(".");
+        _driver->printContent(ultoa(context->_held_from, buf, 10));
+        _driver->printContent("\n");
+    }
+}
+
+void EmbAJAXBase::handleRequest(EmbAJAXBase** _children, size_t NUM, EmbAJAXElementIndex* index, void (*change_callback)()) {
     char conversion_buf[EMBAJAX_MAX_ID_LEN];
+    _driver->beginResponse(EmbAJAXMetrics::Poll);
 
     // handle value changes sent from client
-    uint16_t client_revision = atoi(_driver->getArg("revision", conversion_buf, EMBAJAX_MAX_ID_LEN));
-    if (client_revision > _driver->revision()) {
-        // This could happen on overflow, or if the server has rebooted, but not the client.
-        // Setting revision to 0, here, means that all elements are considered changed, and will be
-        // synced to the client.
-        client_revision = 0;
-    }
-    const char *id = _driver->getArg("id", conversion_buf, EMBAJAX_MAX_ID_LEN);
-    EmbAJAXElement *element = (id[0] == '\0') ? 0 : findChild(id);
-    if (element) {
+    uint32_t client_token = strtoul(_driver->getArg("client", conversion_buf, EMBAJAX_MAX_ID_LEN), 0, 10);
+    // If the client claims a revision it has never been sent, the server has probably rebooted, but not the client.
+    // Setting revision to 0, here, means that all elements are considered changed, and will be synced to the client.
+    uint32_t client_revision = _driver->readClientRevision("revision", client_token);
+    buildIndex(_children, NUM, index);
+
+    // A request may carry several changes, as id/value, id1/value1, id2/value2, ...
+    EmbAJAXElement *changed[EMBAJAX_MAX_CHANGES_PER_REQUEST];
+    uint32_t changed_revisions[EMBAJAX_MAX_CHANGES_PER_REQUEST];
+    uint8_t num_changed = 0;
+    char idarg[12] = "id";
+    char valuearg[12] = "value";
+    for (uint8_t i = 0; i < EMBAJAX_MAX_CHANGES_PER_REQUEST; ++i) {
+        if (i > 0) {
+            itoa(i, idarg + 2, 10);
+            itoa(i, valuearg + 5, 10);
+        }
+        const char *id = _driver->getArg(idarg, conversion_buf, EMBAJAX_MAX_ID_LEN);
+        if (id[0] == '\0') break;
+        EmbAJAXElement *element = index->find(id);
+        if (!element) element = findChild(_children, NUM, id);  // not in index, e.g. inside a custom container class
+        if (!element) continue;
 #if EMBAJAX_DEBUG > 2
         Serial.print("Updating ");
         Serial.println(id);
@@ -637,20 +2119,28 @@ void EmbAJAXBase::handleRequest(EmbAJAXBase** _children, size_t NUM, void (*chan
         Serial.print(" old value ");
         Serial.println(element->value());
 #endif
-        element->updateFromDriverArg("value");
-        element->setChanged();                  // See bottom of function for an explanation on revision handling here, and in general
-        element->revision = client_revision;
+        element->updateFromDriverArg(valuearg);
+        _driver->lock();
+        element->publishChange();               // See bottom of function for an explanation on revision handling here, and in general
+        element->_echoed = true;
+        changed[num_changed] = element;
+        changed_revisions[num_changed++] = element->revision;
+        _driver->unlock();
         if (change_callback) change_callback();
 #if EMBAJAX_DEBUG > 2
-        Serial.print("(temp) new revision ");
+        Serial.print("new revision ");
         Serial.print(element->revision);
         Serial.print(" new value ");
         Serial.println(element->value());
 #endif
     }
+    if (_driver->_deferred_changes) publishDeferred(index);
+    _driver->lock();
     _driver->nextRevision();
+    const uint32_t revision = _driver->revision();
+    _driver->unlock();
 #if EMBAJAX_DEBUG > 2
-    if (element || (EMBAJAX_DEBUG > 3)) {
+    if (num_changed || (EMBAJAX_DEBUG > 3)) {
         Serial.print("Update done. Client revision ");
         Serial.print(client_revision);
         Serial.print(" driver revision ");
@@ -659,10 +2149,21 @@ void EmbAJAXBase::handleRequest(EmbAJAXBase** _children, size_t NUM, void (*chan
 #endif
 
     // then relay value changes that have occured in the server (possibly in response to those sent)
+    _driver->setClientRevision(client_token, revision);
+    EmbAJAXOutputContext* context = _driver->context();
+    context->_echo_elements = changed;
+    context->_echo_revisions = changed_revisions;
+    context->_num_echo = num_changed;
+    if (_driver->precomputesContentLength()) {
+        _driver->beginMeasuring();
+        printUpdates(_children, NUM, index, client_revision, revision);
+        _driver->endMeasuring();
+    }
     _driver->printHeader(false);
-    _driver->printFormatted("{\"revision\": ", INTEGER_VALUE(_driver->revision()), ",\n\"updates\": [\n");
-    sendUpdates(_children, NUM, client_revision, true);
-    _driver->printContent("\n]}\n");
+    printUpdates(_children, NUM, index, client_revision, revision);
+    _driver->flush();
+    context->_num_echo = 0;
+    context->_bulk_from = EmbAJAXElementIndex::npos;
 
     /* Explanation on revision handling:
      * Bascis - Revision signifies what changes a particular client has already seen. Each client keeps a separate revision number. Each element hold the reivison number of
@@ -674,8 +2175,9 @@ void EmbAJAXBase::handleRequest(EmbAJAXBase** _children, size_t NUM, void (*chan
      *          may be changed. We want to sync all of that _except_ the value which was sent by the client itself. This is rather important, as messages will always arrive with
      *          at least a few ms delay. If, e.g. the user is typing in a text input, syncing back the change could easily happen _after_ the user has already typed another key.
      *          This key would then get "swallowed".
-     *          To avoid syncing back this change, while still making sure any secondary change is synced: We first call setChanged() (so that the driver is aware that a new
-     *          revision may be needed). Then, we re-set the revision to the revision number of the client. Usually it will stay that way, unless secondary changes trigger another
-     *          update. Finally, after syncing back changes, we increase the revision, again, such that all further clients will be updated, appropriately. */
-    if (element) element->revision = _driver->revision();
+     *          To avoid syncing back this change, while still making sure any secondary change is synced: We publish the change as usual (so that all other clients will
+     *          be sent it), but remember the element and the revision of that change in the output context of this response. EmbAJAXElement::changed() skips the element
+     *          for this response, only, unless it has been published again, since (a secondary change, e.g. in the change callback, or from another task,
+     *          see EMBAJAX_THREAD_SAFE). Since this state is per response, other clients being sent updates at the same time are not affected.
+     *          The same applies to each element, if several changes are sent in one request. */
 }
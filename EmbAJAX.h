@@ -26,6 +26,108 @@
 /** Maximum length to assume for id strings. Reducing this could help to reduce RAM usage, a little. */
 #define EMBAJAX_MAX_ID_LEN 16
 
+/** Size of the buffer passed to EmbAJAXElement::formatValue(). Large enough for any 32 bit integer, or an HTML color. */
+#define EMBAJAX_VALUE_BUFLEN 12
+
+/** Size of the output buffer. Output is collected in this buffer, and only handed to the server, when it is full, or when the response is
+ *  complete. Larger values mean fewer, larger writes (and thus e.g. fewer TCP segments and chunked-encoding frames), at the cost of RAM.
+ *  The default for ESP32 and RP2040 is chosen to fill a TCP segment (1460 bytes MSS), leaving some room for the chunk header. May be
+ *  overridden using a build flag (e.g. -DEMBAJAX_OUTPUT_BUFFER_SIZE=256).
+ *
+ *  Each response generated at the same time needs its own buffer (see EmbAJAXOutputContext). EmbAJAXOutputDriverESPAsync allocates these on
+ *  the heap, per request. Custom drivers should not place an EmbAJAXOutputContext on the stack of a network task, as such stacks are small. */
+#ifndef EMBAJAX_OUTPUT_BUFFER_SIZE
+#if defined(ESP32) || defined(ARDUINO_ARCH_RP2040)
+#define EMBAJAX_OUTPUT_BUFFER_SIZE 1436
+#elif defined(ESP8266)
+#define EMBAJAX_OUTPUT_BUFFER_SIZE 512
+#else
+#define EMBAJAX_OUTPUT_BUFFER_SIZE 64
+#endif
+#endif
+
+/** Whether to include support for gzip-compressed responses (see EmbAJAXOutputDriverBase::setCompressionEnabled()). This adds some
+ *  code size, and is thus disabled by default on small MCUs. Define to 0 (e.g. -DEMBAJAX_USE_GZIP=0) to leave out the encoder on any MCU. */
+#ifndef EMBAJAX_USE_GZIP
+#if defined(ESP32) || defined(ESP8266) || defined(ARDUINO_ARCH_RP2040)
+#define EMBAJAX_USE_GZIP 1
+#else
+#define EMBAJAX_USE_GZIP 0
+#endif
+#endif
+
+/** Number of clients to keep track of. This is used to tell, reliably, which revision each client has actually been sent, e.g. to detect
+ *  a reboot of the server. If more clients than this are connected, the least recently seen client will be forgotten, and will receive all
+ *  states on its next request. May be overridden using a build flag (e.g. -DEMBAJAX_MAX_CLIENTS=16). */
+#ifndef EMBAJAX_MAX_CLIENTS
+#if defined(__AVR__)
+#define EMBAJAX_MAX_CLIENTS 4
+#else
+#define EMBAJAX_MAX_CLIENTS 8
+#endif
+#endif
+
+/** Maximum number of value changes a client may send in a single request. Changes queued on the client, while a request is pending, are sent
+ *  together, in the next request, up to this limit. */
+#define EMBAJAX_MAX_CHANGES_PER_REQUEST 16
+
+/** Approximate limit for the size of requests sent by the client (in bytes). Changes queued on the client are sent in a single request only
+ *  as long as it stays below this size. Single values larger than this are still sent, though. See also EmbAJAXScriptedSpan::setReceiveHandler(). */
+#define EMBAJAX_MAX_REQUEST_SIZE 1024
+
+/** Maximum size of a single argument value to be read in chunks by the base implementation of EmbAJAXOutputDriverBase::getArgChunk() (only used
+ *  with drivers that do not override it). Values received with EmbAJAXScriptedSpan::setReceiveHandler() are split into parts well below this. */
+#define EMBAJAX_MAX_ARG_SCRATCH (2 * EMBAJAX_MAX_REQUEST_SIZE)
+
+/** Maximum interval (in ms) between two polls of an idle client. Clients poll once per second, while there are changes, and back off
+ *  exponentially up to this interval, while nothing changes. Any input on the client, or any update from the server, resets the interval.
+ *  Clients do not poll at all, while the page is hidden (e.g. in a background tab). Can be changed at runtime, using
+ *  EmbAJAXOutputDriverBase::setMaxPollInterval(). */
+#define EMBAJAX_MAX_POLL_INTERVAL 8000
+
+/** Number of recent element changes to keep track of. This allows sending updates to clients (and, in particular, answering idle polls),
+ *  without having to check every element on the page. Clients lagging behind by more changes than this will be updated by checking
+ *  every element, as a fallback. Each entry costs a few bytes of RAM. Set to 0 to disable (e.g. -DEMBAJAX_CHANGE_RING_SIZE=0). */
+#ifndef EMBAJAX_CHANGE_RING_SIZE
+#if defined(__AVR__)
+#define EMBAJAX_CHANGE_RING_SIZE 8
+#else
+#define EMBAJAX_CHANGE_RING_SIZE 32
+#endif
+#endif
+
+/** Whether to collect performance counters (requests, response times, output sizes, see EmbAJAXMetrics). This costs about 150 bytes of RAM, and
+ *  two calls to micros() per response. The counters can be read using EmbAJAXOutputDriverBase::metrics(), or served as text, see
+ *  EmbAJAXOutputDriverBase::setMetricsPath(). Disabled by default on AVR. Define to 0 (e.g. -DEMBAJAX_METRICS=0) to disable on any MCU. */
+#ifndef EMBAJAX_METRICS
+#if defined(__AVR__)
+#define EMBAJAX_METRICS 0
+#else
+#define EMBAJAX_METRICS 1
+#endif
+#endif
+
+/** \def EMBAJAX_THREAD_SAFE
+ * If set to 1, the bookkeeping of revisions and changes is protected by a (short) critical section, so that element values may be set from one
+ * task, while requests are handled in another. This is the case with EmbAJAXOutputDriverESPAsync, where requests are handled in the async TCP
+ * task, possibly on the other core of the ESP32. Enabled by default on ESP32. May be overridden using a build flag, e.g. -DEMBAJAX_THREAD_SAFE=0
+ * on ESP32 with the (synchronous) WebServer, or -DEMBAJAX_THREAD_SAFE=1 for other multi-task setups. The latter requires FreeRTOS critical
+ * sections (portMUX_TYPE, portENTER_CRITICAL()) as provided by ESP-IDF, and thread_local support. See docs/Technical.md for details. */
+#ifndef EMBAJAX_THREAD_SAFE
+#if defined(ESP32)
+#define EMBAJAX_THREAD_SAFE 1
+#else
+#define EMBAJAX_THREAD_SAFE 0
+#endif
+#endif
+
+// Internal: Storage for per-task state, see EmbAJAXOutputDriverBase::setContext()
+#if EMBAJAX_THREAD_SAFE
+#define EMBAJAX_THREAD_LOCAL thread_local
+#else
+#define EMBAJAX_THREAD_LOCAL
+#endif
+
 /** \def EMBAJAX_DEBUG
  * Set to a value above 0 for diagnostics on Serial and browser console (for troubleshooting, only, as it increase flash, RAM, and processing requirements,
  * considerably. */
@@ -63,7 +165,11 @@
 #include "macro_definitions.h"
 
 class EmbAJAXOutputDriverBase;
+class EmbAJAXOutputContext;
 class EmbAJAXElement;
+class EmbAJAXElementIndex;
+class EmbAJAXPageCache;
+class EmbAJAXGzip;
 class EmbAJAXContainerBase;
 class EmbAJAXPageBase;
 
@@ -82,11 +188,13 @@ public:
     /** serialize pending changes for the client. Virtual so you could customize it, completely, but
      *  instead you probably want to override EmbAJAXElement::valueProperty(), only, instead.
      *
+     *  See EmbAJAXElement::sendUpdates() for the format.
+     *
      *  @param since revision number last sent to the server. Send only changes that occured since this revision.
-     *  @param first if false, @em and this object writes any update, it should write a ',', first.
+     *  @param first true, if nothing has been written to the response, yet.
      *  @returns true if anything has been written, false otherwise.
      */
-    virtual bool sendUpdates(uint16_t since, bool first) {
+    virtual bool sendUpdates(uint32_t since, bool first) {
         UNUSED(since);
         UNUSED(first);
         return false;
@@ -111,6 +219,7 @@ public:
         Enabledness=1,
         Value=2,
         FirstElementSpecificProperty=3,
+        Deferred=6,      ///< Set on the contents of hidden EmbAJAXHideableContainer with setDeferUpdates(). Updates are held back.
         HTMLAllowed=7
     };
     /** Find child element of this one, with the given id. Returns 0, if this is not a container, or
@@ -119,24 +228,204 @@ public:
         UNUSED(id);
         return 0;
     }
+    /** @returns the number of direct children of this object, if it is a container, 0 otherwise. @see child() */
+    virtual size_t numChildren() const {
+        return 0;
+    }
+    /** @returns the direct child at the given position (0 <= num < numChildren()). */
+    virtual EmbAJAXBase* child(size_t num) const {
+        UNUSED(num);
+        return 0;
+    }
 protected:
 template<size_t NUM> friend class EmbAJAXContainer;
     virtual void setBasicProperty(uint8_t num, bool status) { UNUSED(num); UNUSED(status); };
 
     static EmbAJAXOutputDriverBase *_driver;
-    static char itoa_buf[8];
     constexpr static const char null_string[1] = "";
 
     /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXContainer::printChildren() */
     void printChildren(EmbAJAXBase** children, size_t num) const;
     /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXContainer::sendUpdates() */
-    bool sendUpdates(EmbAJAXBase** children, size_t num, uint16_t since, bool first);
+    bool sendUpdates(EmbAJAXBase** children, size_t num, uint32_t since, bool first);
+    /** Send updates for all elements in index that have changed since the given revision, based on the changes recorded in the driver
+     *  (see EmbAJAXOutputDriverBase::recordChange()).
+     *  @returns false, if not possible (because the record does not reach back far enough), in which case nothing has been sent. */
+    bool sendRecordedUpdates(EmbAJAXBase** children, size_t num, const EmbAJAXElementIndex* index, uint32_t since);
+    /** Mark all elements inside the given container (recursively) that have changed since the given revision as changed, again, such
+     *  that they will be sent to all clients. Used for the changes held back by EmbAJAXHideableContainer::setDeferUpdates(). */
+    static void republishChanged(const EmbAJAXBase* container, uint32_t since);
     /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXContainer::findChild() */
     EmbAJAXElement* findChild(EmbAJAXBase** children, size_t num, const char*id) const;
+    /** Helper for handleRequest(): Publish any changes held back by EmbAJAXElement::setPublishInterval(), which are due. */
+    void publishDeferred(const EmbAJAXElementIndex* index);
+    /** Helper for printPage() and handleRequest(): Build the index, if that has not happened, yet. */
+    void buildIndex(EmbAJAXBase** children, size_t num, EmbAJAXElementIndex* index) const;
     /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXPage::print() */
-    void printPage(EmbAJAXBase** children, size_t num, const char* _title, const char* _header, uint16_t _min_interval) const;
+    void printPage(EmbAJAXBase** children, size_t num, const char* _title, const char* _header, uint16_t _min_interval, uint8_t _poll_number, EmbAJAXElementIndex* index, EmbAJAXPageCache* cache) const;
+    /** Helper for printPage(): Everything, except the header. */
+    void printPageContents(EmbAJAXBase** children, size_t num, const char* _title, const char* _header, uint16_t _min_interval, uint8_t _poll_number, const EmbAJAXElementIndex* index) const;
+    /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXPage::layoutVersion() */
+    uint32_t layoutVersion(EmbAJAXBase** children, size_t num, const char* _title, const char* _header, uint16_t _min_interval, uint8_t _poll_number, EmbAJAXElementIndex* index, EmbAJAXPageCache* cache) const;
+    /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXPage::preparePoll() */
+    void preparePoll(EmbAJAXBase** children, size_t num, EmbAJAXElementIndex* index);
+    /** Helper for handleRequest(): Print the response, i.e. all changes since the given revision, up to the given (current) revision. */
+    void printUpdates(EmbAJAXBase** children, size_t num, const EmbAJAXElementIndex* index, uint32_t since, uint32_t revision);
     /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXPage::handleRequest() */
-    void handleRequest(EmbAJAXBase** children, size_t num, void (*change_callback)());
+    void handleRequest(EmbAJAXBase** children, size_t num, EmbAJAXElementIndex* index, void (*change_callback)());
+    /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXPage::handleBinary() */
+    void handleBinary(EmbAJAXBase** children, size_t num, EmbAJAXElementIndex* index, const uint8_t* data, size_t len, void (*change_callback)());
+};
+
+/** @brief State of a single response being generated
+ *
+ *  Holds everything that EmbAJAXOutputDriverBase needs to keep track of while generating one response: The output buffer,
+ *  whether output is being measured, or compressed, and the page being sent updates for. By default, each driver uses a single,
+ *  built-in context. Drivers that may generate several responses at the same time (in different tasks) use one context per
+ *  request, instead, see EmbAJAXOutputDriverBase::setContext(). Drivers may derive from this class to keep their own per-request
+ *  data (such as the request object of the server) along with it. */
+class EmbAJAXOutputContext {
+public:
+    EmbAJAXOutputContext() {};
+private:
+friend class EmbAJAXOutputDriverBase;
+friend class EmbAJAXBase;
+friend class EmbAJAXElement;
+friend class EmbAJAXControlTableBase;
+    char _buf[EMBAJAX_OUTPUT_BUFFER_SIZE];
+    size_t _bufpos = 0;
+    bool _measuring = false;
+    size_t _content_length = 0;
+    char* _capture = 0;
+    size_t _capture_size = 0;
+    bool _compressing = false;
+    /** Index of the page currently being sent updates for (see EmbAJAXBase::printUpdates()), 0 while not sending updates. */
+    const EmbAJAXElementIndex* _update_index = 0;
+    /** Total size of the output passed on, so far. Used to keep track of the size of updates, see EmbAJAXOutputDriverBase::setUpdateBudget() */
+    size_t _emitted = 0;
+    size_t _update_start = 0;
+    /** Priority of the elements being sent, in EmbAJAXBase::printUpdates(), 0xFF for all */
+    uint8_t _update_pass = 0xFF;
+    /** Whether an element with EmbAJAXElement::BulkPriority has been sent, in this response */
+    bool _bulk_sent = false;
+    /** Updates held back from earlier responses to this client, due to EmbAJAXOutputDriverBase::setUpdateBudget(): Elements with
+     *  EmbAJAXElement::BulkPriority from position _bulk_from (in the index) onwards have been sent changes up to _bulk_since, only, all other
+     *  elements up to _update_since. _bulk_from is EmbAJAXElementIndex::npos, if nothing is held back. */
+    uint32_t _update_since = 0;
+    uint32_t _bulk_since = 0;
+    size_t _bulk_from = (size_t) -1;
+    /** Lowest position of the elements held back from this response, EmbAJAXElementIndex::npos for none */
+    size_t _held_from = (size_t) -1;
+    /** Elements changed by the client of this response, and the revision of each change. These are not echoed back to the client,
+     *  unless changed again, see EmbAJAXBase::handleRequest(). */
+    EmbAJAXElement* const* _echo_elements = 0;
+    const uint32_t* _echo_revisions = 0;
+    uint8_t _num_echo = 0;
+    /** While measuring: Whether to keep a hash of the output, see EmbAJAXBase::layoutVersion() */
+    bool _hashing = false;
+    uint32_t _hash = 0;
+    /** ETag to send with the page being loaded, see EmbAJAXOutputDriverBase::checkPageETag() */
+    char _etag[11] = "";
+#if EMBAJAX_METRICS
+    /** Type of the response being generated (an EmbAJAXMetrics::ResponseType), and what has been sent for it, so far */
+    uint8_t _response_type = 0xFF;
+    uint32_t _response_start = 0;
+    uint32_t _sent_bytes = 0;
+    uint32_t _sent_calls = 0;
+#endif
+};
+
+/** @brief Lookup of the arguments in an url-encoded request body ("id=x&value=y&...")
+ *
+ *  The body is split into (offset, length) slices once, in parse(). Values are decoded directly into the caller's buffer, on lookup.
+ *  There are no allocations, and the body is not copied, i.e. it needs to remain valid while in use. This is used by drivers that have
+ *  access to the raw request body, to implement EmbAJAXOutputDriverBase::getArg() and EmbAJAXOutputDriverBase::getArgChunk(). */
+class EmbAJAXRequestArgs {
+public:
+    EmbAJAXRequestArgs() : _body(0), _num(0) {};
+    /** Split the given body into arguments. Arguments beyond the first few (enough for a request carrying
+     *  EMBAJAX_MAX_CHANGES_PER_REQUEST changes) are ignored.
+     *  @returns false, if the body is too large (more than 65535 bytes). No arguments are available, then, and the request should be refused. */
+    bool parse(const char* body, size_t len);
+    /** @returns true, if parse() has been called. */
+    bool valid() const {
+        return _body;
+    }
+    /** Decode the value of the given argument, starting at offset (after decoding), into buf. The result is not 0-terminated.
+     *  @returns the number of bytes written to buf. 0, if the argument is missing. */
+    size_t get(const char* name, size_t offset, char* buf, size_t buflen) const;
+    /** Like above, but 0-terminated, as needed for EmbAJAXOutputDriverBase::getArg(). @returns buf */
+    const char* get(const char* name, char* buf, int buflen) const {
+        buf[get(name, 0, buf, buflen - 1)] = '\0';
+        return buf;
+    }
+private:
+    enum {
+        MaxChangeArgs = 2 * EMBAJAX_MAX_CHANGES_PER_REQUEST + 2,  // id/value for each change, client, and revision
+        MaxPollArgs = 3 * EMBAJAX_MAX_CLIENTS,                     // page/client/revision for each page in a shared poll
+        MaxArgs = MaxChangeArgs > MaxPollArgs ? MaxChangeArgs : MaxPollArgs
+    };
+    const char* _body;
+    struct {
+        uint16_t name;
+        uint16_t value;
+        uint16_t end;
+    } _args[MaxArgs];
+    uint8_t _num;
+};
+
+/** @brief Performance counters
+ *
+ *  Collected by EmbAJAXOutputDriverBase, if EMBAJAX_METRICS is enabled. All counters start at 0, and count up from there (wrapping around,
+ *  eventually), so rates are best computed by whoever reads them, from the difference between two readings. */
+class EmbAJAXMetrics {
+public:
+    EmbAJAXMetrics() {
+        reset();
+    }
+    /** Kinds of responses counted separately */
+    enum ResponseType {
+        PageLoad = 0,  ///< EmbAJAXPage::printPage(), or 304 Not Modified (see EmbAJAXOutputDriverBase::setPageETagsEnabled())
+        Poll = 1,      ///< EmbAJAXPage::handleRequest(), whether or not carrying any changes
+        NumResponseTypes = 2,
+        None = 0xFF    ///< Not counted, e.g. the client script
+    };
+    enum {
+        NumBuckets = 8
+    };
+    /** @returns the upper limit of the given bucket of the response time histogram (in µs): 128, 256, ... The last bucket has no limit. */
+    static uint32_t bucketLimit(uint8_t bucket) {
+        return 128ul << bucket;
+    }
+    struct Counters {
+        /** Number of responses */
+        uint32_t responses;
+        /** Number of responses by time needed to generate them (from the start of printPage() or handleRequest(), to the final flush()),
+         *  non-cumulative. See bucketLimit() */
+        uint32_t histogram[NumBuckets];
+        /** Total time needed, in µs */
+        uint64_t time;
+        /** Total bytes passed to EmbAJAXOutputDriverBase::printContent(const char*, size_t) (after compression, if any) */
+        uint64_t bytes;
+        /** Total calls to EmbAJAXOutputDriverBase::printContent(const char*, size_t) */
+        uint32_t calls;
+        /** Responses per 10 seconds, averaged over the most recent window of at least 5 seconds */
+        uint32_t rate;
+        /** Responses in the current window */
+        uint32_t window;
+    } counters[NumResponseTypes];
+    /** Number of polls from clients at (or reset to) revision 0, i.e. that had to be sent the states of all elements. This includes the first
+     *  request after each page load, but also clients that lost track (e.g. after a failed request), or the server having rebooted. */
+    uint32_t full_syncs;
+
+    /** Reset all counters to 0 */
+    void reset();
+    /** Count a response of the given type. @param now current time in ms */
+    void record(uint8_t type, uint32_t time, uint32_t bytes, uint32_t calls, uint32_t now);
+    /** Update the rate of responses, if the current window is complete. @param now current time in ms */
+    void updateRates(uint32_t now);
+private:
+    uint32_t _window_start;
 };
 
 /** @brief Abstract base class for output drivers/server implementations
@@ -147,7 +436,8 @@ template<size_t NUM> friend class EmbAJAXContainer;
  *
  *  Providing your own driver is very easy. All you have to do it to wrap the
  *  basic functions for writing to the server and retrieving (POST) arguments:
- *  printHeader(), printContent(), and getArg().
+ *  printHeader(), printContent(const char*, size_t), and getArg(). Drivers should also override getArgChunk(), if they can read an
+ *  argument from an offset, directly. The base implementation works on top of getArg(), but is slow, and limited in size.
  */
 class EmbAJAXOutputDriverBase {
 public:
@@ -157,8 +447,82 @@ public:
     }
 
     virtual void printHeader(bool html) = 0;
-    virtual void printContent(const char *content) = 0;
+    /** Print the given content. This is buffered (see EMBAJAX_OUTPUT_BUFFER_SIZE), and will only be passed to the server, when the
+     *  buffer is full, or on flush(). */
+    void printContent(const char *content) {
+        _printContent(content);
+    }
+    /** Pass len bytes of content to the server, immediately. Must be implemented in the driver. The content is not necessarily
+     *  0-terminated. */
+    virtual void printContent(const char *content, size_t len) = 0;
+    /** Pass any buffered output to the server. Called at the end of each response. */
+    void flush();
+    /** Pass len bytes of content to printContent(const char*, size_t), keeping count for EmbAJAXMetrics. Internal, public for technical reasons. */
+    void _sendContent(const char *content, size_t len) {
+#if EMBAJAX_METRICS
+        EmbAJAXOutputContext* ctx = context();
+        ctx->_sent_bytes += len;
+        ++ctx->_sent_calls;
+#endif
+        printContent(content, len);
+    }
+    /** Compress responses (with gzip), if the client supports it. This reduces network traffic to less than half, typically, at the
+     *  cost of some CPU time, and about 3.5kB of RAM, which is allocated when calling this. Requires EMBAJAX_USE_GZIP.
+     *  @returns false, if compression is not available. */
+    virtual bool setCompressionEnabled(bool enabled = true);
+    /** Send an ETag identifying the layout of the page with each page load, and answer page loads from clients that already have a copy
+     *  of the page (If-None-Match) with "304 Not Modified", instead of the page. Reloads of an unchanged page then cost only a few bytes.
+     *  Any values shown in the copy that the client already has are brought up to date by its first request, just like for a fresh
+     *  copy. The layout is determined by rendering the page once (without sending it), and again after each setStructureChanged().
+     *  Disabled by default. */
+    virtual void setPageETagsEnabled(bool enabled = true) {
+        _page_etags = enabled;
+    }
+    /** @returns true, if the length of each response should be determined before sending it. See EmbAJAXOutputDriverGeneric::setPrecomputeContentLength() */
+    bool precomputesContentLength() const {
+        return _precompute_length;
+    }
+    /** Start measuring the length of the output. Until endMeasuring(), any output is counted, but not sent.
+     *  @param capture If not 0, the output is also copied into this buffer (up to capture_size bytes). */
+    void beginMeasuring(char* capture = 0, size_t capture_size = 0);
+    /** Stop measuring. The length measured will be available from contentLength() until the end of the response. */
+    void endMeasuring();
+    /** @returns the length of the response, if known in advance (see beginMeasuring()), 0 otherwise. */
+    size_t contentLength() {
+        return context()->_content_length;
+    }
+    /** Direct all output from the calling task to the given context, until called again. Pass 0 to switch back to the default (built-in)
+     *  context. This allows a driver to generate several responses at the same time, from different tasks (if EMBAJAX_THREAD_SAFE), with
+     *  one context per request. The context must stay valid until the end of the response.
+     *
+     *  @note Simple drivers that handle one request at a time do not need to call this, at all. */
+    void setContext(EmbAJAXOutputContext* context) {
+        _context = context;
+    }
+    /** @returns the context that output from the calling task is directed to, see setContext(). */
+    EmbAJAXOutputContext* context() {
+        return _context ? _context : &_default_context;
+    }
+    /** Send a complete response, the content of which is already known (e.g. a cached page). */
+    void printResponse(bool html, const char* content, size_t len);
+    /** Signal that the HTML representation of some element has changed in a way that cannot be synced to the client via
+     *  updates (e.g. a changed attribute that is only printed on page load). This invalidates any cached pages, see
+     *  EmbAJAXPage::setCacheEnabled(). */
+    void setStructureChanged() {
+        ++_structure_revision;
+    }
+    uint16_t structureRevision() const {
+        return _structure_revision;
+    }
     virtual const char* getArg(const char* name, char* buf, int buflen) = 0;
+    /** Read a part of the value of the given argument, starting at the given offset (in bytes, after decoding). Unlike getArg(), this allows to
+     *  process values of any size in chunks, without a buffer for the value as a whole (see e.g. EmbAJAXScriptedSpan::setReceiveHandler()).
+     *
+     *  The base implementation reads the value using getArg(), from the start, into a temporary buffer on the heap, each time. This is slow, and
+     *  limited to values of EMBAJAX_MAX_ARG_SCRATCH bytes. Drivers that have access to the raw request should override it (see EmbAJAXRequestArgs).
+     *
+     *  @returns the number of bytes written to buf (not 0-terminated). If this is less than buflen, the end of the value has been reached. */
+    virtual size_t getArgChunk(const char* name, size_t offset, char* buf, size_t buflen);
     /** Set up the given page to be served on the given path.
      *
      *  @param change_callback See EmbAJAXPage::handleRequest() for details.
@@ -166,22 +530,152 @@ public:
     virtual void installPage(EmbAJAXPageBase *page, const char *path, void (*change_callback)()=0) = 0;
     /** Insert this hook into loop(). Takes care of the appropriate server calls, if needed. */
     virtual void loopHook() = 0;
+    /** Serve the client side script (which is identical for all pages) as a separate resource on the given path, instead of
+     *  inlining it into each page. The script is sent with headers that allow the browser to cache it, permanently, so subsequent
+     *  page loads will only transfer the markup of the page itself.
+     *
+     *  Call this before installPage(). The default implementation does nothing, i.e. drivers not supporting this will keep
+     *  inlining the script. */
+    virtual void installScript(const char *path = "/embajax.js") { UNUSED(path); };
+    /** @returns true, if the driver can push updates to the client over a WebSocket (see EmbAJAXOutputDriverESPAsync::setWebSocketEnabled()).
+     *  Base implementation returns false, which means the client will poll for updates. */
+    virtual bool hasPushTransport() const { return false; };
+    /** Serve the performance counters (see EmbAJAXMetrics) as plain text on the given path, in the Prometheus text format, for scraping by
+     *  monitoring software. Call this before installPage(). The path is registered along with the first page installed (by the built-in drivers;
+     *  custom drivers need to take care of this, themselves). Requires EMBAJAX_METRICS. */
+    void setMetricsPath(const char *path = "/embajax/metrics") {
+        _metrics_path = path;
+    }
+    /** Print the performance counters, as served on the metrics path (see setMetricsPath()), including the header. */
+    void printMetrics();
+    /** Poll all pages installed after this (i.e. call this before installPage()) via a single path: If several of these pages are open in
+     *  the same browser (e.g. in different tabs), only one of them polls the server, on behalf of all others that have nothing to send,
+     *  and passes on their part of the reply. Each page still receives its own updates, only, but the server answers one request,
+     *  instead of one per page. Requests carrying changes are still sent to the path of the page.
+     *
+     *  Pages find each other using a BroadcastChannel, where supported by the browser. Pages that are hidden, or connected via
+     *  WebSocket (see EmbAJAXOutputDriverESPAsync::setWebSocketEnabled()), do not take part. Up to EMBAJAX_MAX_CLIENTS pages are
+     *  polled per request. This adds about 2kB to the client script, best combined with installScript().
+     *
+     *  The path is registered along with the first page installed (by the built-in drivers; custom drivers need to call addPolledPage()
+     *  for each page, and arrange for handlePoll() to be called on POST requests to the path). */
+    void setPollPath(const char *path = "/embajax/poll") {
+        _poll_path = path;
+        _script_length = 0;  // script changes, see printScript()
+    }
+    /** @returns the path set by setPollPath(), 0 if none. */
+    const char* pollPath() const {
+        return _poll_path;
+    }
+    /** Handle a shared poll, see setPollPath(). To be called by the driver, for requests on that path.
+     *
+     *  Request format: page=n&client=token&revision=r for the first page, followed by page1, client1, revision1, etc., for further pages.
+     *  The response holds the reply to each of these (as for a regular poll of that page, see EmbAJAXBase::printUpdates()), in order,
+     *  separated by lines containing only "#". */
+    void handlePoll();
+#if EMBAJAX_METRICS
+    /** @returns the performance counters collected so far. Note that these may be updated from a different task, while you read them
+     *  (see EMBAJAX_THREAD_SAFE). */
+    const EmbAJAXMetrics& metrics() const {
+        return _metrics;
+    }
+    /** Reset all performance counters to 0 */
+    void resetMetrics() {
+        lock();
+        _metrics.reset();
+        unlock();
+    }
+#endif
+    /** @returns the number of clients that have sent a request within the given time (cf. EmbAJAXPage::hasActiveClient()). Clients are
+     *  told apart by a random token. At most EMBAJAX_MAX_CLIENTS are counted.
+     *  @param latency_ms 0 to use the default, see activeLatency() */
+    uint8_t activeClients(uint32_t latency_ms = 0);
+    /** Suggest a different maximum interval between polls of idle clients (default: EMBAJAX_MAX_POLL_INTERVAL) to the clients. The value is
+     *  sent along with each response, i.e. it takes effect with the next request of each client. Values below 1000 make clients poll more
+     *  often than the default, all the time.
+     *
+     *  @note Changes sent from the server may take this long to be seen by an idle client, unless a WebSocket is connected (see
+     *        EmbAJAXOutputDriverESPAsync::setWebSocketEnabled()). */
+    void setMaxPollInterval(uint16_t interval_ms) {
+        _max_poll_interval = interval_ms;
+        _announce_poll_interval = true;
+    }
+    uint16_t maxPollInterval() const {
+        return _max_poll_interval;
+    }
+    /** @returns the time (ms) after which a client that has not sent any request is considered gone (in EmbAJAXPage::hasActiveClient(), and
+     *  activeClients()): 4 seconds more than maxPollInterval(), but at least 5 seconds. */
+    uint32_t activeLatency() const {
+        return max(5000ul, _max_poll_interval + 4000ul);
+    }
+    /** Limit the size of the updates sent in each response to approximately the given number of bytes (default 0: no limit). Only changes
+     *  to elements with EmbAJAXElement::BulkPriority are subject to this limit. Those that do not fit are sent in reply to the next
+     *  request of the same client, instead (the client is told which elements it has not been sent, yet, see EmbAJAXBase::printUpdates()). At least one such element is sent per response, even if it exceeds the limit on its own. Use this to keep large
+     *  values (e.g. a log view) from delaying the updates of other elements, on slow links. */
+    void setUpdateBudget(uint16_t bytes) {
+        _update_budget = bytes;
+    }
+    /** @returns the path of the client script as set up by installScript(), or 0, if the script is inlined into each page. */
+    const char* scriptPath() const {
+        return _script_path;
+    }
+    /** @returns an identifier (hash) of the client script. This is used as the ETag, and is appended to the script URL, so that
+     *  browsers will not hold on to an outdated (cached) script after a firmware update. */
+    const char* scriptVersion();
+    /** Print the client side script (without surrounding \<script\> tags) to the response. */
+    void printScript();
+    /** @returns length of the client side script in bytes. */
+    size_t scriptLength();
 
-    uint16_t revision() const {
+    uint32_t revision() const {
         return _revision;
     }
-    uint16_t setChanged() {
+    /** @returns the revision that the next change will be recorded at. If this differs from revision(), there are changes that have not been
+     *  synced to any client, yet. */
+    uint32_t pendingRevision() const {
+        return next_revision;
+    }
+    uint32_t setChanged() {
         next_revision = _revision+1;
         return (next_revision);
     }
+    /** Enter the critical section protecting revisions and recorded changes (see EMBAJAX_THREAD_SAFE). Calls may be nested, but the
+     *  lock must only be held for a few instructions, and never while producing output. Internal, public for technical reasons. */
+    void lock() {
+#if EMBAJAX_THREAD_SAFE
+        portENTER_CRITICAL(&_lock);
+#endif
+    }
+    /** Counterpart to lock() */
+    void unlock() {
+#if EMBAJAX_THREAD_SAFE
+        portEXIT_CRITICAL(&_lock);
+#endif
+    }
     void nextRevision() {
         _revision = next_revision;
     }
+    /** Check the revision reported by a client against the revision that was actually sent to that client, before.
+     *  @param token random identifier sent by the client (0, if unavailable)
+     *  @param revision revision as reported by the client
+     *  @returns the revision that it is safe to assume the client is at. This will be 0 - i.e. all states need sending - for
+     *           clients that are reporting a revision that they have never been sent, which typically means that the server
+     *           has rebooted, while the client has not. */
+    uint32_t clientRevision(uint32_t token, uint32_t revision);
+    /** Read the revision reported by a client from the given argument, and check it, see clientRevision(). This may include updates held
+     *  back from that client ("<revision>.<revision of bulk elements>.<position>", see EmbAJAXBase::printUpdates()), which are stored in the
+     *  current context. */
+    uint32_t readClientRevision(const char* argname, uint32_t token);
+    /** Note that the given client has been sent all changes up to the given revision. */
+    void setClientRevision(uint32_t token, uint32_t revision);
+    /** Keep track of a change to the given element, which has been assigned the given revision. Called from EmbAJAXElement::setChanged(). */
+    void recordChange(EmbAJAXElement* element, uint32_t revision);
     /** Quotation modes. Used in printFiltered() */
     enum QuoteMode {
         NotQuoted,  ///< Will not be quoted
         JSQuoted,   ///< Will be quoted suitable for JavaScript
-        HTMLQuoted  ///< Will be quoted suitable for HTML attributes
+        HTMLQuoted, ///< Will be quoted suitable for HTML attributes
+        JSEscaped   ///< Escaped like JSQuoted, but without the surrounding quotes
     };
     /** Print the given value filtered according to the parameters:
      *
@@ -194,12 +688,21 @@ public:
      *                     (safe for untrusted user input). */
     void printFiltered(const char* value, QuoteMode quoted, bool HTMLescaped) {
         _printFiltered(value, quoted, HTMLescaped);
-        commitBuffer();
+    }
+    /** Like printFiltered(), for values known not to contain any characters that would need escaping (such as numbers): Only adds
+     *  the quotes, if any. */
+    void printPlain(const char* value, QuoteMode quoted) {
+        bool quotes = (quoted == JSQuoted || quoted == HTMLQuoted);
+        if (quotes) _printChar('"');
+        _printContent(value);
+        if (quotes) _printChar('"');
     }
     /** Shorthand for printFiltered(value, JSQuoted, false); */
     inline void printJSQuoted (const char* value) { printFiltered (value, JSQuoted, false); }
     /** Shorthand for printFiltered(value, HTMLQuoted, false); */
     inline void printHTMLQuoted (const char* value) { printFiltered (value, HTMLQuoted, false); }
+    /** Print the given integer (base 10). Unlike INTEGER_VALUE() in #printFormatted(...), this is not limited to the size of int. */
+    inline void printInteger (int32_t value) { _printInteger (value); }
     /** Convenience function to print an attribute inside an HTML tag.
      *  This function adds a space _in front of_ the printed attribute.
      *
@@ -226,16 +729,110 @@ public:
 #if USE_PROGMEM_STRINGS
     void _printContentF(const __FlashStringHelper*, ...);
 #endif
+    /** Like _printContentF(), but with the length of each static segment of fmt passed in front of each argument (and at the end), so
+     *  the static parts can be copied in bulk, instead of being scanned for argument placeholders. Used by #printFormatted(...), which
+     *  determines the lengths at compile time. Internal, public for technical reasons. */
+    void _printSegmentsF(const char* fmt, ...);
+#if USE_PROGMEM_STRINGS
+    void _printSegmentsF(const __FlashStringHelper*, ...);
+#endif
+protected:
+    /** To be called by the driver in printHeader(): Start compressing this response, if enabled, and the client accepts gzip encoding.
+     *  @returns true, if the response will be compressed, in which case the driver needs to send a "Content-Encoding: gzip" header (and must
+     *           not send contentLength()). */
+    bool beginCompression(bool client_accepts_gzip);
+    /** To be called by the driver before handling a page load, if setPageETagsEnabled(): Compare the client's If-None-Match header (0 if
+     *  none) to the current layout version of the page. The ETag to send is then available from pageETag().
+     *  @returns true, if the client's copy is up to date, and the request should be answered with 304 Not Modified, and pageETag(),
+     *           followed by flush(). */
+    bool checkPageETag(EmbAJAXPageBase* page, const char* if_none_match);
+    /** @returns The ETag to send (in printHeader()) along with the page being loaded, 0 if none. See checkPageETag() */
+    const char* pageETag() {
+        EmbAJAXOutputContext* ctx = context();
+        return ctx->_etag[0] ? ctx->_etag : 0;
+    }
+    /** To be called by the driver in installPage(), if pollPath() is set: Let the page take part in the shared poll. */
+    void addPolledPage(EmbAJAXPageBase* page);
+    const char* _script_path = 0;
+    bool _precompute_length = false;
+    /** See setMetricsPath(). To be registered by the driver in installPage(), if set, and not _metrics_installed, yet */
+    const char* _metrics_path = 0;
+    bool _metrics_installed = false;
+    bool _page_etags = false;
+    /** See setPollPath(). To be registered by the driver in installPage(), if set, and not _poll_installed, yet */
+    const char* _poll_path = 0;
+    bool _poll_installed = false;
 private:
+    uint16_t _max_poll_interval = EMBAJAX_MAX_POLL_INTERVAL;
+    /** Whether _max_poll_interval needs to be sent to clients, see EmbAJAXBase::printUpdates() */
+    bool _announce_poll_interval = false;
+    /** Whether any element has been assigned a priority other than the default, see EmbAJAXElement::setUpdatePriority() */
+    bool _priorities_used = false;
+    uint16_t _update_budget = 0;
+    /** Note the start of a response of the given EmbAJAXMetrics::ResponseType. It is counted on the next flush(). */
+    void beginResponse(uint8_t type) {
+#if EMBAJAX_METRICS
+        EmbAJAXOutputContext* ctx = context();
+        ctx->_response_type = type;
+        ctx->_response_start = micros();
+#else
+        UNUSED(type);
+#endif
+    }
+    void hashScript();
+    static const char client_script[];
+    /** Addition to client_script, if pollPath() is set */
+    static const char poll_script[];
+    /** Pages taking part in the shared poll, see addPolledPage() */
+    EmbAJAXPageBase* _polled_pages = 0;
+    char _script_version[9] = "";
+    size_t _script_length = 0;
     void _printFiltered(const char* value, QuoteMode quoted, bool HTMLescaped);
     void _printContent(const char* content);
+    void _printInteger(int32_t value);
+    void _printStatic(const char* content, size_t len);
+#if USE_PROGMEM_STRINGS
+    void _printStaticP(PGM_P content, size_t len);
+#endif
     void _printChar(const char content);
-    void commitBuffer();
-    const int _bufsize = 64;
-    char _buf[64];
-    int _bufpos = 0;
-    uint16_t _revision;
-    uint16_t next_revision;
+    void emit(EmbAJAXOutputContext* ctx, const char* content, size_t len);
+    void commitBuffer(EmbAJAXOutputContext* ctx);
+    EmbAJAXOutputContext _default_context;
+    static EMBAJAX_THREAD_LOCAL EmbAJAXOutputContext* _context;
+    uint16_t _structure_revision = 0;
+friend class EmbAJAXBase;
+friend class EmbAJAXElement;
+    /** Number of elements with changes held back, see EmbAJAXElement::setPublishInterval() */
+    uint16_t _deferred_changes = 0;
+    EmbAJAXGzip* _gzip = 0;
+    /** The context currently using _gzip, if any. There is only one compressor, further concurrent responses are sent uncompressed. */
+    EmbAJAXOutputContext* _gzip_user = 0;
+    uint32_t _revision;
+    uint32_t next_revision;
+#if EMBAJAX_THREAD_SAFE
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+    struct ClientRecord {
+        uint32_t token;
+        uint32_t revision;
+        uint32_t last_seen;
+    };
+    ClientRecord _clients[EMBAJAX_MAX_CLIENTS] = {};
+#if EMBAJAX_METRICS
+    EmbAJAXMetrics _metrics;
+#endif
+#if EMBAJAX_CHANGE_RING_SIZE > 0
+    struct ChangeRecord {
+        uint32_t revision;
+        EmbAJAXElement* element;
+    };
+    /** Ring buffer of the most recent changes, in order of revision. */
+    ChangeRecord _changes[EMBAJAX_CHANGE_RING_SIZE];
+    uint8_t _changes_end = 0;
+    uint8_t _changes_count = 0;
+    /** Changes are recorded completely for clients at this revision, or above. */
+    uint32_t _changes_floor = 1;
+#endif
 };
 
 /** Convenience macro to set up an EmbAJAXPage, without counting the number of elements for the template. See EmbAJAXPage::EmbAJAXPage()
@@ -265,8 +862,9 @@ protected:
 
 /** @brief connection status indicator
  *
- *  This passive element can be inserted into a page to indicate the connection status: If there is no reply from the server for 5 seconds,
- *  the connection to the server is assumed to be broken.
+ *  This passive element can be inserted into a page to indicate the connection status: If there is no reply from the server for 5 seconds
+ *  (or 4 seconds more than the current poll interval of the client, if longer, see EMBAJAX_MAX_POLL_INTERVAL), the connection to the server
+ *  is assumed to be broken.
  *
  *  @note While this is a "dynamic" display, the entire logic is implemented on the client, for obvious reasons. From the point of view of the
  *        server, this is a static element. */
@@ -306,7 +904,11 @@ public:
     const char* id() const {
         return _id;
     }
-    bool sendUpdates(uint16_t since, bool first) override;
+    /** Send all properties of this element (see valueProperty()), if it has changed since the given revision. Each property is
+     *  sent as a single line of the form "element:property:value", where element and property are numbers from the tables sent
+     *  along with the page (see EmbAJAXElementIndex), and value is escaped for "\\" and newlines. Elements or properties missing
+     *  from those tables are sent as a JSON array of id, property, and value, instead. */
+    bool sendUpdates(uint32_t since, bool first) override;
 
     /** const char representation of the current server side value. Must be implemented in derived class.
      *  This base class handles visibility and enabledness, only. Do call the base implementation for
@@ -317,6 +919,30 @@ public:
         return 0;
     }
 
+    /** Like value(), but elements that need to format their value (e.g. from a number) will do so into the given buffer, rather than
+     *  into a shared static one. This is what is used internally, for sending updates. Elements with numeric values should override
+     *  this, and implement value() in terms of it. The base implementation simply returns value().
+     *
+     *  @param buf buffer of at least EMBAJAX_VALUE_BUFLEN bytes. The returned pointer may or may not point to this.
+     *  @param bufsize size of buf */
+    virtual const char* formatValue(uint8_t which, char* buf, size_t bufsize) const {
+        UNUSED(buf);
+        UNUSED(bufsize);
+        return value(which);
+    }
+
+    /** Hook for elements with values that are too large for formatValue(), or that depend on what the client has already been sent
+     *  (see e.g. EmbAJAXTimeSeries): Print the value of the given property directly, using printFiltered() (or similar) with the given
+     *  quoting mode. The base implementation prints nothing, and returns false, in which case formatValue() is sent, instead.
+     *
+     *  @param since revision of the client, as passed to sendUpdates() */
+    virtual bool printValue(uint8_t which, uint32_t since, EmbAJAXOutputDriverBase::QuoteMode quoted) const {
+        UNUSED(which);
+        UNUSED(since);
+        UNUSED(quoted);
+        return false;
+    }
+
     /** Returns true, if the value may contain HTML, and needs HTML escaping when passed to the client.
      *  Base implementation simply returns false. */
     virtual bool valueNeedsEscaping(uint8_t which = EmbAJAXBase::Value) const {
@@ -324,9 +950,17 @@ public:
         return false;
     }
 
+    /** Returns true, if the value is known never to contain any characters needing quoting or escaping (e.g. because it is a number),
+     *  so it can be sent without scanning it. Base implementation returns true for visibility and enabledness, false otherwise. */
+    virtual bool valueIsPlain(uint8_t which = EmbAJAXBase::Value) const {
+        return (which == EmbAJAXBase::Visibility || which == EmbAJAXBase::Enabledness);
+    }
+
      /** The JS property that will have to be set on the client. Must be implemented in derived class.
       *  This base class handles visibility and enabledness, only. Do call the base implementation for
-      *  any "which" that is _not_ handled in your derived class. */
+      *  any "which" that is _not_ handled in your derived class.
+      *
+      *  The returned string is not copied, and should not change over the lifetime of the element. */
     virtual const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const {
         if (which == EmbAJAXBase::Visibility) return ("style.display");
         if (which == EmbAJAXBase::Enabledness) return ("disabled");
@@ -339,25 +973,78 @@ public:
         UNUSED(argname);
         return;
     }
+    /** override this in your derived class to accept compact binary samples from the client, in addition to updateFromDriverArg().
+     *  These are sent as binary WebSocket messages by custom client code (see EmbAJAXJoystick for an example), and thus only arrive
+     *  with drivers supporting a push transport (see EmbAJAXOutputDriverBase::hasPushTransport()). Such samples bypass the request
+     *  queue of the client, and no reply is sent for them. The implementation need not call setChanged().
+     *
+     *  @param data payload of the sample, i.e. not including the element number (see EmbAJAXPage::handleBinary()).
+     *  @returns true, if the sample was valid. */
+    virtual bool updateFromBinary(const uint8_t* data, size_t len) {
+        UNUSED(data);
+        UNUSED(len);
+        return false;
+    }
 
     EmbAJAXElement *toElement() override final {
         return this;
     }
+    /** Limit how often changes to this element are sent to clients: At most once per the given interval (in ms, default 0 - no limit).
+     *  Changes in between are coalesced. The value itself is updated right away, but clients will be sent the latest value only once
+     *  the interval has passed: On the next change after that, or else on the next request of any client. This allows to call setValue()
+     *  (and friends) at a much higher rate (e.g. from a sensor loop) than would make sense to transmit. */
+    void setPublishInterval(uint16_t interval);
+    /** Priority classes for sending updates, see setUpdatePriority() */
+    enum UpdatePriority {
+        ControlPriority,   ///< Sent first
+        StatusPriority,    ///< Sent after changes to elements with ControlPriority. The default.
+        BulkPriority,      ///< Sent last, and subject to EmbAJAXOutputDriverBase::setUpdateBudget()
+        NumUpdatePriorities
+    };
+    /** Set the priority of changes to this element: Within each response, the changes to all elements with ControlPriority are sent first,
+     *  followed by StatusPriority (the default), followed by BulkPriority. Changes to elements with BulkPriority may be held back until
+     *  the next request, see EmbAJAXOutputDriverBase::setUpdateBudget().
+     *
+     *  For containers, such as EmbAJAXHideableContainer, this affects the properties of the container itself, only.
+     *  @note Custom elements overriding sendUpdates() need to call the base implementation for this to take effect. */
+    void setUpdatePriority(UpdatePriority priority);
+    UpdatePriority updatePriority() const {
+        return (UpdatePriority) _priority;
+    }
 protected:
     void setBasicProperty(uint8_t num, bool status) override;
     bool basicProperty(uint8_t num) const {
         return (_flags & (1 << num));
     }
+    // NOTE: Members are ordered by size, so that small members of derived classes can use the padding at the end (saves a few bytes, each).
+    const char* _id;
+private:
+    uint32_t revision;
+protected:
+    /** Time (millis(), lower 16 bits) of the latest change sent, see setPublishInterval(). */
+    uint16_t _published;
+    uint16_t _publish_interval;
     byte _flags;
+    /** Set while a change is held back due to setPublishInterval(). */
+    bool _publish_pending : 1;
+    /** Set while the latest change was received from a client, and is not to be echoed back to it, see EmbAJAXBase::handleRequest(). */
+    bool _echoed : 1;
+    /** See setUpdatePriority() */
+    uint8_t _priority;
 template<size_t NUM> friend class EmbAJAXPage;
 friend class EmbAJAXBase;
-    const char* _id;
+    /** Mark this element as changed, i.e. to be sent to clients. Subject to setPublishInterval(). */
     void setChanged();
-    bool changed(uint16_t since);
+    /** Like setChanged(), but immediately, regardless of setPublishInterval(). */
+    void publishChange();
+    /** Publish a change held back due to setPublishInterval(), if the interval has passed, by now. */
+    void publishIfDue();
+    bool changed(uint32_t since);
+    /** Helper for setters taking a string that is not copied: @returns a checksum of the given string (which may be 0), so that
+     *  unchanged values can be detected. See EmbAJAXMutableSpan::setSkipUnchanged(). */
+    static uint32_t checksum(const char* value);
     /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXTextInput::print() */
     void printTextInput(size_t size, const char* value) const;
-private:
-    uint16_t revision;
 };
 
 /** @brief An HTML span element with content that can be updated from the server (not the client) */
@@ -365,6 +1052,8 @@ class EmbAJAXMutableSpan : public EmbAJAXElement {
 public:
     EmbAJAXMutableSpan(const char* id) : EmbAJAXElement(id) {
         _value = 0;
+        _skip_unchanged = false;
+        _checksum = 0;
     }
     void print() const override;
     const char* value(uint8_t which = EmbAJAXBase::Value) const override;
@@ -378,9 +1067,18 @@ public:
      *                    if false (the default), any "<" and "&" in value will be escaped,
      *                    before rendering on the client, making the string plain but safe. */
     void setValue(const char* value, bool allowHTML = false);
+    /** If enabled, setValue() will keep a checksum of the value, and ignore calls that do not actually change the content. Useful if
+     *  you call setValue() periodically, with content that changes only every now and then. Disabled by default, as this takes a
+     *  few bytes of RAM, and some CPU time (proportional to the length of the value) on each call. In the (very rare) case of a
+     *  checksum collision, a change would be missed.
+     *
+     *  See also setPublishInterval(), to limit the rate of updates for values that do change frequently. */
+    void setSkipUnchanged(bool skip = true);
     bool valueNeedsEscaping(uint8_t which=EmbAJAXBase::Value) const override;
 private:
+    bool _skip_unchanged;
     const char* _value;
+    uint32_t _checksum;
 };
 
 /** @brief A text input field.
@@ -409,6 +1107,7 @@ public:
     /** Set the text inputs content to the given value. Note: In this particular case, the value passed _is_ copied,
      *  you can safely pass a temporary string. */
     void setValue(const char* value) {
+        if (strncmp(_value, value, SIZE) == 0) return;
         strncpy(_value, value, SIZE);
         setChanged();
     }
@@ -424,7 +1123,10 @@ class EmbAJAXSlider : public EmbAJAXElement {
 public:
     EmbAJAXSlider(const char* id, int16_t min, int16_t max, int16_t initial);
     void print() const override;
+    /** @note The value is formatted into a static buffer, which will be overwritten on the next call. See formatValue(). */
     const char* value(uint8_t which = EmbAJAXBase::Value) const override;
+    const char* formatValue(uint8_t which, char* buf, size_t bufsize) const override;
+    bool valueIsPlain(uint8_t which = EmbAJAXBase::Value) const override;
     const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override;
     void setValue(int16_t value);
     int16_t intValue() const {
@@ -444,7 +1146,10 @@ public:
      *  @param b Initial value for blue */
     EmbAJAXColorPicker(const char* id, uint8_t r, uint8_t g, uint8_t b);
     void print() const override;
+    /** @note The value is formatted into a static buffer, which will be overwritten on the next call. See formatValue(). */
     const char* value(uint8_t which = EmbAJAXBase::Value) const override;
+    const char* formatValue(uint8_t which, char* buf, size_t bufsize) const override;
+    bool valueIsPlain(uint8_t which = EmbAJAXBase::Value) const override;
     const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override;
     void setColor(uint8_t r, uint8_t g, uint8_t b);
     uint8_t red() const;
@@ -530,6 +1235,7 @@ public:
     EmbAJAXCheckButton(const char* id, const char* label=nullptr, bool checked=false);
     void print() const override;
     const char* value(uint8_t which = EmbAJAXBase::Value) const override;
+    bool valueIsPlain(uint8_t which = EmbAJAXBase::Value) const override;
     const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override;
     void setChecked(bool checked);
     bool isChecked() const {
@@ -562,13 +1268,19 @@ public:
     void print() const override {
         EmbAJAXBase::printChildren(_children, NUM);
     }
-    bool sendUpdates(uint16_t since, bool first) override {
+    bool sendUpdates(uint32_t since, bool first) override {
         return EmbAJAXBase::sendUpdates(_children, NUM, since, first);
     }
     /** Recursively look for a child (hopefully, there is only one) of the given id, and return a pointer to it. */
     EmbAJAXElement* findChild(const char*id) const override final {
         return EmbAJAXBase::findChild(_children, NUM, id);
     }
+    size_t numChildren() const override {
+        return NUM;
+    }
+    EmbAJAXBase* child(size_t num) const override {
+        return _children[num];
+    }
 protected:
     void setBasicProperty(uint8_t num, bool status) override {
         for (uint8_t i = 0; i < NUM; ++i) {
@@ -597,6 +1309,8 @@ template<size_t NUM> class EmbAJAXHideableContainer : public EmbAJAXElement {
 public:
     EmbAJAXHideableContainer(const char* id, EmbAJAXBase *children[NUM]) : EmbAJAXElement(id) {
         _childlist = EmbAJAXContainer<NUM>(children);
+        _defer_updates = false;
+        _deferred_since = 0;
     }
     void print() const override {
         _driver->printFormatted("<div id=", HTML_QUOTED_STRING(_id), ">");
@@ -606,16 +1320,63 @@ public:
     EmbAJAXElement* findChild(const char* id) const override {
         return _childlist.findChild(id);
     }
-    bool sendUpdates(uint16_t since, bool first) override {
+    size_t numChildren() const override {
+        return NUM;
+    }
+    EmbAJAXBase* child(size_t num) const override {
+        return _childlist.child(num);
+    }
+    bool sendUpdates(uint32_t since, bool first) override {
         bool sent = EmbAJAXElement::sendUpdates(since, first);
+        if (deferring()) {
+            // Updates to the children are held back, and will have to be sent to this client, once shown
+            _driver->lock();  // may be served concurrently with loop(), see updateDeferral()
+            if (since < _deferred_since) _deferred_since = since;
+            _driver->unlock();
+            return sent;
+        }
         bool sent2 = _childlist.sendUpdates(since, first && !sent);
         return sent || sent2;
     }
+    /** If enabled, no updates are sent for the contents of this container, while it is hidden (and thus, not visible on the client,
+     *  anyway). This reduces the size of updates for pages with many hidden panels (e.g. tabs). Anything changed while hidden is sent,
+     *  once, when the container is shown, again. Disabled, by default.
+     *
+     *  @note While hidden, the elements inside the container will not be updated on the client, even if they are also inserted,
+     *        elsewhere on the page. */
+    void setDeferUpdates(bool defer) {
+        bool was_deferring = deferring();
+        _defer_updates = defer;
+        updateDeferral(was_deferring);
+    }
 protected:
     void setBasicProperty(uint8_t num, bool status) override {
+        bool was_deferring = deferring();
         EmbAJAXElement::setBasicProperty(num, status);
         _childlist.setBasicProperty(num, status);
+        if (num == EmbAJAXBase::Visibility) updateDeferral(was_deferring);
+    }
+    bool deferring() const {
+        return _defer_updates && !basicProperty(EmbAJAXBase::Visibility);
     }
+    void updateDeferral(bool was_deferring) {
+        if (deferring() == was_deferring) return;
+        if (!was_deferring) {
+            _driver->lock();
+            _deferred_since = _driver->revision();
+            _driver->unlock();
+            _childlist.setBasicProperty(EmbAJAXBase::Deferred, true);
+        } else {
+            _childlist.setBasicProperty(EmbAJAXBase::Deferred, false);
+            _driver->lock();
+            uint32_t since = _deferred_since;
+            _driver->unlock();
+            republishChanged(&_childlist, since);
+        }
+    }
+    bool _defer_updates;
+    /** Oldest revision of a client that has not been sent (all) changes to the children, since starting to defer updates */
+    uint32_t _deferred_since;
     EmbAJAXContainer<NUM> _childlist;
 };
 
@@ -632,10 +1393,20 @@ public:
      *  @param selected_option index of the default option. 0 by default, for the first option, may be > NUM, for
      *                         no option selected by default. */
     EmbAJAXRadioGroup(const char* id_base, const char* options[NUM], uint8_t selected_option = 0) : EmbAJAXContainer<NUM>(), EmbAJAXRadioGroupBase() {
+        // The ids of all buttons are kept in a single allocation of just the size needed, instead of EMBAJAX_MAX_ID_LEN bytes for each
+        size_t len = strlen(id_base);
+        if (len > EMBAJAX_MAX_ID_LEN-4) len = EMBAJAX_MAX_ID_LEN-4;
+        const size_t stride = len + (NUM > 100 ? 3 : (NUM > 10 ? 2 : 1)) + 1;
+        childids = (char*) malloc(NUM * stride);
         for (uint8_t i = 0; i < NUM; ++i) {
-            char* childid = childids[i];
-            strncpy(childid, id_base, EMBAJAX_MAX_ID_LEN-4);
-            itoa(i, &(childid[strlen(childid)]), 10);
+            // NOTE: Out of memory should not happen, this early. If it does, the buttons have no ids, and will not be usable on the client.
+            const char* childid = EmbAJAXBase::null_string;
+            if (childids) {
+                char* buf = childids + i * stride;
+                memcpy(buf, id_base, len);
+                itoa(i, buf + len, 10);
+                childid = buf;
+            }
             buttons[i] = EmbAJAXCheckButton(childid, options[i], i == selected_option);
             buttons[i].radiogroup = this;
             buttonpointers[i] = &buttons[i];
@@ -644,6 +1415,12 @@ public:
          EmbAJAXContainer<NUM>::_children = buttonpointers;  // Hm, why do I need to specify EmbAJAXContainer<NUM>::, explicitly?
         _name = id_base;
     }
+    ~EmbAJAXRadioGroup() {
+        free(childids);
+    }
+    // Owns the ids of its buttons, and is referred to by them. Not copyable.
+    EmbAJAXRadioGroup(const EmbAJAXRadioGroup&) = delete;
+    EmbAJAXRadioGroup& operator=(const EmbAJAXRadioGroup&) = delete;
     /** Select / check the option at the given index. All other options in this radio group will become deselected. */
     void selectOption(uint8_t num) {
         for (uint8_t i = 0; i < NUM; ++i) {
@@ -664,7 +1441,7 @@ public:
 private:
     EmbAJAXCheckButton buttons[NUM]; /** NOTE: Internally, the radio groups allocates individual check buttons. This is the storage space for those. */
     EmbAJAXBase* buttonpointers[NUM];
-    char childids[NUM][EMBAJAX_MAX_ID_LEN];
+    char* childids;
     int8_t _current_option;
     void selectButton(EmbAJAXCheckButton* which) override {
         _current_option = -1;
@@ -685,7 +1462,10 @@ public:
     void selectOption(uint8_t num);
     /** @return the index of the currently selected option */
     uint8_t selectedOption() const;
+    /** @note The value is formatted into a static buffer, which will be overwritten on the next call. See formatValue(). */
     const char* value(uint8_t which = EmbAJAXBase::Value) const override;
+    const char* formatValue(uint8_t which, char* buf, size_t bufsize) const override;
+    bool valueIsPlain(uint8_t which = EmbAJAXBase::Value) const override;
     const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override;
     void updateFromDriverArg(const char* argname) override;
 protected:
@@ -718,13 +1498,186 @@ private:
     const char* _labels[NUM];
 };
 
+/** \def EMBAJAX_TABLE_LABEL_LEN
+ * Maximum length of the labels of an EmbAJAXControlTable (including the terminating 0). These are kept in flash, along with the rest of
+ * the description of each row. May be overridden using a build flag (e.g. -DEMBAJAX_TABLE_LABEL_LEN=32). */
+#ifndef EMBAJAX_TABLE_LABEL_LEN
+#define EMBAJAX_TABLE_LABEL_LEN 24
+#endif
+
+/** @brief Description of one row of an EmbAJAXControlTable. Meant to be kept in flash (PROGMEM), see there. */
+struct EmbAJAXControlTableRow {
+    enum Type {
+        Slider,    ///< An input of type range, like EmbAJAXSlider
+        CheckBox,  ///< A check box, like EmbAJAXCheckButton. The value is 1 if checked, 0 otherwise.
+        Readout    ///< The value shown as text. Can be set on the server, only.
+    };
+    uint8_t type;      ///< One of Type
+    int16_t min;       ///< Minimum value of a Slider (ignored for other types)
+    int16_t max;       ///< Maximum value of a Slider (ignored for other types)
+    int16_t initial;   ///< Initial value
+    char label[EMBAJAX_TABLE_LABEL_LEN];  ///< Shown in front of the control (behind a CheckBox). Not escaped, so it may contain HTML.
+};
+
+/** @brief Abstract base class for EmbAJAXControlTable. */
+class EmbAJAXControlTableBase : public EmbAJAXElement {
+public:
+    void print() const override;
+    bool sendUpdates(uint32_t since, bool first) override;
+    EmbAJAXElement* findChild(const char* id) const override;
+    void updateFromDriverArg(const char* argname) override;
+    /** @returns the value of the given row (0 <= row < NUM). For a CheckBox, 1 if checked, 0 otherwise. */
+    int16_t rowValue(size_t row) const {
+        return _values[row];
+    }
+    /** Set the value of the given row (0 <= row < NUM). Unlike for regular elements, this is not subject to setPublishInterval(). */
+    void setRowValue(size_t row, int16_t value);
+protected:
+    EmbAJAXControlTableBase(const char* id, const EmbAJAXControlTableRow* rows, size_t num, int16_t* values, uint32_t* revisions, uint8_t* echoed);
+    void setBasicProperty(uint8_t num, bool status) override;
+private:
+    static constexpr size_t NoRow = (size_t) -1;
+    /** @returns the row with the given id ("<table id><row number>"), or NoRow */
+    size_t rowNumber(const char* id) const;
+    /** Write the id of the given row to buf (of at least EMBAJAX_MAX_ID_LEN bytes) */
+    void rowId(size_t row, char* buf) const;
+    uint8_t rowType(size_t row) const {
+        uint8_t type;
+        memcpy_P(&type, &_rows[row].type, sizeof(type));
+        return type;
+    }
+    const EmbAJAXControlTableRow* _rows;
+    size_t _num;
+    int16_t* _values;
+    uint32_t* _revisions;
+    /** One bit per row: Set while the latest change of the row was received from a client, see sendUpdates() */
+    uint8_t* _echoed_rows;
+};
+
+/** @brief Many simple controls, described by a table in flash
+ *
+ *  A regular element (EmbAJAXSlider, EmbAJAXCheckButton, ...) is an object in RAM, with its own vtable pointer, id, flags, and revision.
+ *  For pages with hundreds of controls, that adds up. This class provides an alternative for the most common, simple controls: The
+ *  type, range, initial value, and label of each row are kept in a constant table (in flash, if declared PROGMEM), and the ids are
+ *  generated from the id of the table, followed by the row number (e.g. "ch0", "ch1", ...). In RAM, only the value and revision of each
+ *  row are kept (six bytes per row, plus a bit). Rendering and updates walk the table, rather than a list of objects.
+ *
+ *  @code
+ *  const EmbAJAXControlTableRow channels[] PROGMEM = {
+ *      { EmbAJAXControlTableRow::Slider, 0, 255, 128, "Red" },
+ *      { EmbAJAXControlTableRow::CheckBox, 0, 0, 1, "Enabled" },
+ *      { EmbAJAXControlTableRow::Readout, 0, 0, 0, "Temperature" },
+ *  };
+ *  EmbAJAXControlTable<3> channel_table("ch", channels);
+ *  @endcode
+ *
+ *  Use rowValue() and setRowValue() to access the values, from the change callback of the page, or elsewhere. Visibility and enabledness
+ *  apply to the table as a whole.
+ *
+ *  Changes to rows are sent by id (they are not part of the index sent along with the page, see EmbAJAXElementIndex), i.e. a bit less
+ *  compact than changes to regular elements. Update priorities apply to the table as a whole, but setUpdateBudget() does not.
+ *
+ *  @note Keep the id of the table short, so that the ids of all rows fit into EMBAJAX_MAX_ID_LEN. */
+template<size_t NUM> class EmbAJAXControlTable : public EmbAJAXControlTableBase {
+public:
+    /** ctor.
+     *  @param id id of the table. The rows will be identified by this, followed by the row number.
+     *  @param rows description of the rows. NUM entries, not copied, typically declared const, and PROGMEM. */
+    EmbAJAXControlTable(const char* id, const EmbAJAXControlTableRow* rows) : EmbAJAXControlTableBase(id, rows, NUM, _values, _revisions, _echoed) {}
+private:
+    int16_t _values[NUM];
+    uint32_t _revisions[NUM];
+    uint8_t _echoed[(NUM + 7) / 8];
+};
+
+/** @brief Lookup table of the elements on a page, sorted by id
+ *
+ *  Used internally by EmbAJAXPage to find the element addressed by a client request in O(log n), instead of
+ *  walking the whole tree of elements (and comparing every id) on each request. The index is built on first
+ *  use. Elements that cannot be found in the index (e.g. those inside containers that do not report their
+ *  children via EmbAJAXBase::child()), are still found by a regular EmbAJAXBase::findChild() lookup. */
+class EmbAJAXElementIndex {
+public:
+    EmbAJAXElementIndex() {};
+    ~EmbAJAXElementIndex();
+    /** @returns true, if build() has been completed. */
+    bool isBuilt() const {
+        return _built;
+    }
+    /** Collect all elements from the given list of children (recursively), and sort them by id. */
+    void build(EmbAJAXBase** children, size_t num);
+    /** @returns the element of the given id, or 0, if no such element is in the index. */
+    EmbAJAXElement* find(const char* id) const;
+    /** @returns true, if the given element in in the index. */
+    bool contains(const EmbAJAXElement* element) const {
+        return position(element) != npos;
+    }
+    /** @returns the position of the given element in the index, which is also its number in the element table sent to the client
+     *  (see EmbAJAXElement::sendUpdates()). npos, if the element is not in the index. */
+    size_t position(const EmbAJAXElement* element) const;
+    /** @returns the number of the given property (see EmbAJAXElement::valueProperty()) in the property table sent to the client,
+     *  or npos, if it is not in the table. */
+    size_t propertyNumber(const char* property) const;
+    static constexpr size_t npos = (size_t) -1;
+    /** @returns true, if the index has been built successfully, i.e. contains all elements of the page. */
+    bool isComplete() const {
+        return _complete;
+    }
+private:
+friend class EmbAJAXBase;
+    size_t lowerBound(const char* id) const;
+    static size_t collect(EmbAJAXBase* object, EmbAJAXElement** list, size_t pos);
+    void collectProperties();
+    EmbAJAXElement** _elements = 0;
+    size_t _count = 0;
+    const char** _properties = 0;
+    size_t _num_properties = 0;
+    volatile bool _built = false;
+    bool _building = false;
+    bool _complete = false;
+};
+
+/** @brief Pre-rendered copy of a page
+ *
+ *  Used internally by EmbAJAXPage, see EmbAJAXPage::setCacheEnabled(). */
+class EmbAJAXPageCache {
+public:
+    EmbAJAXPageCache() {};
+    ~EmbAJAXPageCache();
+    /** Discard the cached copy, if any, and set whether a new one should be created on the next page load. */
+    void setEnabled(bool enabled);
+    bool isEnabled() const {
+        return _enabled;
+    }
+private:
+friend class EmbAJAXBase;
+    char* _data = 0;
+    size_t _len = 0;
+    uint16_t _structure_revision = 0;
+    bool _enabled = false;
+    bool _busy = false;
+    /** See EmbAJAXBase::layoutVersion(). Kept here, regardless of whether the cache is enabled. 0, if not yet known. */
+    uint32_t _version = 0;
+    uint16_t _version_structure_revision = 0;
+};
+
 /** @brief Absrract internal helper class
  *
  * Needed for internal reasons. Refer to EmbAJAXPage, instead. */
 class EmbAJAXPageBase {
 public:
     virtual void handleRequest(void (*change_callback)()=0) = 0;
+    virtual void handleBinary(const uint8_t* data, size_t len, void (*change_callback)()=0) = 0;
     virtual void printPage() = 0;
+    virtual uint32_t layoutVersion() = 0;
+    /** Parts of handling a shared poll, see EmbAJAXOutputDriverBase::setPollPath() */
+    virtual void preparePoll() = 0;
+    virtual void printPoll(uint32_t since, uint32_t revision) = 0;
+protected:
+friend class EmbAJAXOutputDriverBase;
+    /** Number of this page in the shared poll (starting at 1), or 0, if not taking part. See EmbAJAXOutputDriverBase::addPolledPage() */
+    uint8_t _poll_number = 0;
+    EmbAJAXPageBase* _next_polled = 0;
 };
 
 /** @brief The main interface class
@@ -749,7 +1702,22 @@ public:
     /** Serve the page including headers and all child elements. You should arrange for this function to be called, whenever
      *  there is a GET request to the desired URL. */
     void print() const override {
-        EmbAJAXBase::printPage(EmbAJAXContainer<NUM>::_children, NUM, _title, _header_add, _min_interval);
+        EmbAJAXBase::printPage(EmbAJAXContainer<NUM>::_children, NUM, _title, _header_add, _min_interval, _poll_number, &_index, &_cache);
+    }
+    /** Keep a pre-rendered copy of this page in RAM (PSRAM on ESP32, if available), so page loads will not need to
+     *  generate it all over, again. This will generally contain outdated values, but the current state of all elements
+     *  is synced by the client's first request, right after loading the page.
+     *
+     *  The copy is re-generated, automatically, if EmbAJAXOutputDriverBase::setStructureChanged() has been called,
+     *  which is taken care of for the built-in elements. Disabled by default, as this costs as much RAM as the size
+     *  of the page. */
+    void setCacheEnabled(bool enabled = true) {
+        _cache.setEnabled(enabled);
+    }
+    /** @returns a fingerprint (hash) of the layout of this page, which changes after EmbAJAXOutputDriverBase::setStructureChanged().
+     *  Used as the ETag of the page, see EmbAJAXOutputDriverBase::setPageETagsEnabled(). */
+    uint32_t layoutVersion() override {
+        return EmbAJAXBase::layoutVersion(EmbAJAXContainer<NUM>::_children, NUM, _title, _header_add, _min_interval, _poll_number, &_index, &_cache);
     }
     /** Handle AJAX client request. You should arrange for this function to be called, whenever there is a POST request
      *  to whichever URL you served the page itself, from.
@@ -761,12 +1729,33 @@ public:
      *                         (Otherwise the client will be updated on the next poll). */
     void handleRequest(void (*change_callback)()=0) override {
         _latest_ping = millis();
-        EmbAJAXBase::handleRequest(EmbAJAXContainer<NUM>::_children, NUM, change_callback);
+        EmbAJAXBase::handleRequest(EmbAJAXContainer<NUM>::_children, NUM, &_index, change_callback);
+    }
+    /** Handle a binary sample sent by a client (see EmbAJAXElement::updateFromBinary()). Called by drivers supporting a push transport,
+     *  you will not usually have to call this, yourself.
+     *
+     *  Format: The number of the element in the element table sent with the page (16 bit, little endian), followed by the element
+     *  specific payload. Invalid samples are silently dropped.
+     *
+     *  @param change_callback See handleRequest(). */
+    void handleBinary(const uint8_t* data, size_t len, void (*change_callback)()=0) override {
+        EmbAJAXBase::handleBinary(EmbAJAXContainer<NUM>::_children, NUM, &_index, data, len, change_callback);
+    }
+    /** Prepare for sending this page's part of a shared poll (see EmbAJAXOutputDriverBase::setPollPath()). Called by the driver. */
+    void preparePoll() override {
+        _latest_ping = millis();
+        EmbAJAXBase::preparePoll(EmbAJAXContainer<NUM>::_children, NUM, &_index);
+    }
+    /** Print this page's part of a shared poll: All changes since the given revision. Called by the driver, after preparePoll(). */
+    void printPoll(uint32_t since, uint32_t revision) override {
+        EmbAJAXBase::printUpdates(EmbAJAXContainer<NUM>::_children, NUM, &_index, since, revision);
     }
-    /** Returns true if a client seems to be connected (connected clients should send a ping at least once per second; by default this
-     *  function returns whether a ping has been seen within the last 5000 ms.
-     *  @param latency_ms Number of milliseconds to consider as maximum silence period for an active connection */
-    bool hasActiveClient(uint64_t latency_ms=5000) const {
+    /** Returns true if a client seems to be connected (connected clients send a ping at least once per second, while busy, and at least
+     *  every EmbAJAXOutputDriverBase::maxPollInterval() ms, while idle); by default this function returns whether a ping has been seen within
+     *  EmbAJAXOutputDriverBase::activeLatency() (i.e. 12 seconds, by default). Note that clients do not poll while the page is hidden.
+     *  @param latency_ms Number of milliseconds to consider as maximum silence period for an active connection. 0 for the default. */
+    bool hasActiveClient(uint64_t latency_ms=0) const {
+        if (!latency_ms) latency_ms = EmbAJAXBase::_driver->activeLatency();
         return(_latest_ping && (_latest_ping + latency_ms > millis()));
     }
 protected:
@@ -774,6 +1763,8 @@ protected:
     const char* _header_add;
     uint16_t _min_interval;
     uint64_t _latest_ping = 0;
+    mutable EmbAJAXElementIndex _index;
+    mutable EmbAJAXPageCache _cache;
 };
 
 // If the user has not #includ'ed a specific output driver implementation, make a good guess, here
@@ -0,0 +1,185 @@
+/*
+ *
+ * EmbAJAX - Simplistic framework for creating and handling displays and controls on a WebPage served by an Arduino (or other small device).
+ *
+ * Copyright (C) 2018-2023 Thomas Friedrichsmeier
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+// Avoid auto-including an output driver, here.
+#define EMBAJAX_OUTUPUTDRIVER_IMPLEMENTATION
+
+#include "EmbAJAXGzip.h"
+
+#if EMBAJAX_USE_GZIP
+
+#define GZIP_NIL 0xFFFF
+#define GZIP_MIN_MATCH 3
+#define GZIP_MAX_MATCH 258
+
+// Tables from RFC 1951, section 3.2.5
+static const uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+// CRC32, four bits at a time
+static const uint32_t crc_table[16] = { 0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+                                        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C };
+
+static inline uint16_t gzipHash(const uint8_t* p) {
+    return ((p[0] << 6) ^ (p[1] << 3) ^ p[2]) & ((1 << EMBAJAX_GZIP_HASH_BITS) - 1);
+}
+
+void EmbAJAXGzip::begin() {
+    for (uint16_t i = 0; i < (1 << EMBAJAX_GZIP_HASH_BITS); ++i) _head[i] = GZIP_NIL;
+    _winpos = 0;
+    _outpos = 0;
+    _bitbuf = 0;
+    _bitcount = 0;
+    _header_pending = true;
+    _crc = 0xFFFFFFFF;
+    _size = 0;
+}
+
+void EmbAJAXGzip::flushOutput() {
+    if (_outpos) _driver->_sendContent((const char*) _out, _outpos);
+    _outpos = 0;
+}
+
+void EmbAJAXGzip::putByte(uint8_t byte) {
+    if (_outpos >= EMBAJAX_GZIP_OUTPUT_SIZE) flushOutput();
+    _out[_outpos++] = byte;
+}
+
+void EmbAJAXGzip::putBits(uint32_t value, uint8_t count) {
+    _bitbuf |= value << _bitcount;
+    _bitcount += count;
+    while (_bitcount >= 8) {
+        putByte(_bitbuf & 0xFF);
+        _bitbuf >>= 8;
+        _bitcount -= 8;
+    }
+}
+
+void EmbAJAXGzip::putCode(uint16_t code, uint8_t len) {
+    // Huffman codes are packed starting with the most significant bit, i.e. in reverse of everything else
+    uint16_t reversed = 0;
+    for (uint8_t i = 0; i < len; ++i) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    putBits(reversed, len);
+}
+
+void EmbAJAXGzip::putSymbol(uint16_t symbol) {
+    // Fixed Huffman codes for the literal/length alphabet
+    if (symbol < 144) putCode(0x30 + symbol, 8);
+    else if (symbol < 256) putCode(0x190 + symbol - 144, 9);
+    else if (symbol < 280) putCode(symbol - 256, 7);
+    else putCode(0xC0 + symbol - 280, 8);
+}
+
+void EmbAJAXGzip::putMatch(uint16_t len, uint16_t dist) {
+    uint8_t i = 28;
+    while (length_base[i] > len) --i;
+    putSymbol(257 + i);
+    putBits(len - length_base[i], length_extra[i]);
+    i = 29;
+    while (dist_base[i] > dist) --i;
+    putCode(i, 5);
+    putBits(dist - dist_base[i], dist_extra[i]);
+}
+
+void EmbAJAXGzip::write(const char* data, size_t len) {
+    if (_header_pending) {
+        // gzip header: magic, method deflate, no flags, no mtime, no extra flags, unknown OS
+        static const uint8_t header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+        for (uint8_t i = 0; i < 10; ++i) putByte(header[i]);
+        putBits(1, 1);  // BFINAL: The whole stream is a single block...
+        putBits(1, 2);  // ... using fixed Huffman codes
+        _header_pending = false;
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        _crc ^= (uint8_t) data[i];
+        _crc = (_crc >> 4) ^ crc_table[_crc & 15];
+        _crc = (_crc >> 4) ^ crc_table[_crc & 15];
+    }
+    _size += len;
+
+    while (len > 0) {
+        if (_winpos == 2 * EMBAJAX_GZIP_WINDOW) {
+            // Window full: Slide down by half, keeping only the most recent history
+            memmove(_window, _window + EMBAJAX_GZIP_WINDOW, EMBAJAX_GZIP_WINDOW);
+            for (uint16_t i = 0; i < (1 << EMBAJAX_GZIP_HASH_BITS); ++i) {
+                _head[i] = (_head[i] == GZIP_NIL || _head[i] < EMBAJAX_GZIP_WINDOW) ? GZIP_NIL : _head[i] - EMBAJAX_GZIP_WINDOW;
+            }
+            _winpos = EMBAJAX_GZIP_WINDOW;
+        }
+        uint16_t chunk = min(len, (size_t) (2 * EMBAJAX_GZIP_WINDOW - _winpos));
+        memcpy(_window + _winpos, data, chunk);
+        data += chunk;
+        len -= chunk;
+        compress(_winpos + chunk);
+    }
+}
+
+void EmbAJAXGzip::compress(uint16_t end) {
+    // NOTE: Matches will not extend beyond the end of the data written so far. That's not optimal, but saves us from keeping
+    //       track of pending input.
+    uint16_t pos = _winpos;
+    while (pos < end) {
+        uint16_t best_len = 0;
+        uint16_t best_dist = 0;
+        if (end - pos >= GZIP_MIN_MATCH) {
+            uint16_t h = gzipHash(_window + pos);
+            uint16_t candidate = _head[h];
+            _head[h] = pos;
+            if (candidate != GZIP_NIL && pos - candidate <= EMBAJAX_GZIP_WINDOW) {
+                uint16_t max_len = min(end - pos, GZIP_MAX_MATCH);
+                uint16_t len = 0;
+                while (len < max_len && _window[candidate + len] == _window[pos + len]) ++len;
+                if (len >= GZIP_MIN_MATCH) {
+                    best_len = len;
+                    best_dist = pos - candidate;
+                }
+            }
+        }
+        if (best_len) {
+            putMatch(best_len, best_dist);
+            for (uint16_t i = 1; i < best_len && pos + i + GZIP_MIN_MATCH <= end; ++i) {
+                _head[gzipHash(_window + pos + i)] = pos + i;
+            }
+            pos += best_len;
+        } else {
+            putSymbol(_window[pos]);
+            ++pos;
+        }
+    }
+    _winpos = end;
+}
+
+void EmbAJAXGzip::finish() {
+    if (_header_pending) write("", 0);  // empty stream, still needs header
+    putSymbol(256);  // end of block
+    if (_bitcount) putBits(0, 8 - _bitcount);
+    _crc = ~_crc;
+    for (uint8_t i = 0; i < 4; ++i) putByte((_crc >> (8 * i)) & 0xFF);
+    for (uint8_t i = 0; i < 4; ++i) putByte((_size >> (8 * i)) & 0xFF);
+    flushOutput();
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ *
+ * EmbAJAX - Simplistic framework for creating and handling displays and controls on a WebPage served by an Arduino (or other small device).
+ *
+ * Copyright (C) 2018-2023 Thomas Friedrichsmeier
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+#ifndef EMBAJAXGZIP_H
+#define EMBAJAXGZIP_H
+
+#include "EmbAJAX.h"
+
+#if EMBAJAX_USE_GZIP
+
+/** Size of the LZ77 history window. Larger values may give somewhat better compression, at the cost of RAM (two times this value). Must be a power of 2, no larger than 32768. */
+#define EMBAJAX_GZIP_WINDOW 1024
+/** Number of bits for the hash table used to find matches. RAM usage is 2*(2^EMBAJAX_GZIP_HASH_BITS) bytes. */
+#define EMBAJAX_GZIP_HASH_BITS 9
+/** Size of the buffer for compressed output. */
+#define EMBAJAX_GZIP_OUTPUT_SIZE 512
+
+/** @brief Minimal streaming gzip compressor
+ *
+ *  Used internally by EmbAJAXOutputDriverBase, see EmbAJAXOutputDriverBase::setCompressionEnabled().
+ *
+ *  Produces a single deflate block with fixed Huffman codes (as defined in RFC 1951), and a simple, single-candidate
+ *  LZ77 match search. This makes for a very small memory footprint (see the defines, above, no dynamic allocations),
+ *  and little CPU overhead, while still compressing the highly repetitive HTML and JSON generated by EmbAJAX, quite well. */
+class EmbAJAXGzip {
+public:
+    EmbAJAXGzip(EmbAJAXOutputDriverBase* driver) : _driver(driver) {};
+    /** Start a new stream. The gzip header will be written along with the first data. */
+    void begin();
+    /** Compress the given data. Compressed output is passed to EmbAJAXOutputDriverBase::printContent(const char*, size_t), whenever
+     *  the output buffer is full. */
+    void write(const char* data, size_t len);
+    /** End the stream, and pass all remaining output to the driver. */
+    void finish();
+private:
+    void compress(uint16_t end);
+    void putByte(uint8_t byte);
+    void putBits(uint32_t value, uint8_t count);
+    void putCode(uint16_t code, uint8_t len);
+    void putSymbol(uint16_t symbol);
+    void putMatch(uint16_t len, uint16_t dist);
+    void flushOutput();
+
+    EmbAJAXOutputDriverBase* _driver;
+    uint8_t _window[2 * EMBAJAX_GZIP_WINDOW];
+    uint16_t _head[1 << EMBAJAX_GZIP_HASH_BITS];
+    uint16_t _winpos;
+    uint8_t _out[EMBAJAX_GZIP_OUTPUT_SIZE];
+    uint16_t _outpos;
+    uint32_t _bitbuf;
+    uint8_t _bitcount;
+    bool _header_pending;
+    uint32_t _crc;
+    uint32_t _size;
+};
+
+#endif
+#endif
@@ -50,6 +50,21 @@ public:
         _height = height;
         _position_adjust = position_adjust;
         _snap_back = snap_back;
+        _interval = 20;
+        _curx = _cury = 0;
+        _pressed = false;
+        updateValueString();
+    }
+    /** Set the minimum interval (ms) between two position samples sent by the client, while the joystick is being moved (default: 20).
+     *  Intermediate positions are dropped, i.e. the latest position always wins. Presses and releases are always sent, immediately.
+     *
+     *  If the driver supports a push transport (see EmbAJAXOutputDriverESPAsync::setWebSocketEnabled()), samples are sent as small binary
+     *  WebSocket messages, bypassing the regular request queue (and its minimum interval). Otherwise, they are sent as regular requests.
+     *
+     *  @note Takes effect on the next page load. */
+    void setSampleInterval(uint16_t interval_ms) {
+        _interval = interval_ms;
+        if (EmbAJAXBase::_driver) EmbAJAXBase::_driver->setStructureChanged();
     }
     void print() const override {
         EmbAJAXBase::_driver->printFormatted("<canvas id=", HTML_QUOTED_STRING(_id), " width=", INTEGER_VALUE(_width), " height=", INTEGER_VALUE(_height),
@@ -57,7 +72,11 @@ public:
                                             "<script>\n"
                                             "var elem = document.getElementById(", JS_QUOTED_STRING(_id), ");\n");
         EmbAJAXBase::_driver->printFormatted(
+           "elem.pressed = 0;\n"
+           "elem.num = element_ids.indexOf(elem.id);\n"
+           "elem.sent = 0;\n"
            "elem.__defineSetter__('coords', function(value) {\n"
+           "  if (this.pressed) return;\n"  // while the user is moving the stick, the local position wins (samples sent in binary are synced back)
            "  var vals = value.split(',');\n"
            "  this.update(vals[0], vals[1], false);\n"
            "});\n"
@@ -82,8 +101,22 @@ public:
            "    var ctx = this.getContext('2d');\n"
            "    ctx.clearRect(0, 0, this.width, this.height);\n"
            "    this.drawKnob(ctx, this.posx, this.posy);\n"
-           "    if(send) doRequest(this.id,this.pressed + ',' + this.posx + ',' + this.posy, nomerge ? 2 : 1);\n"
+           "    if(send) this.send(nomerge);\n"
+           "  }\n"
+           "}\n"
+           "\n"
+           "elem.send = function(nomerge=false) {\n"  // at most one sample per interval. The timer sends whatever position is current, by then
+           "  var now = Date.now();\n"
+           "  if (!nomerge && now - this.sent < ", INTEGER_VALUE(_interval), ") {\n"
+           "    if (!this.timer) this.timer = setTimeout(function() { this.timer = 0; this.send(); }.bind(this), ", INTEGER_VALUE(_interval), " - now + this.sent);\n"
+           "    return;\n"
            "  }\n"
+           "  this.sent = now;\n"
+           "  if (ws && this.num >= 0) {\n"   // fixed size sample: element number, x, y (16 bit, little endian), pressed
+           "    var b = new DataView(new ArrayBuffer(7));\n"
+           "    b.setUint16(0, this.num, true); b.setInt16(2, this.posx, true); b.setInt16(4, this.posy, true); b.setUint8(6, this.pressed);\n"
+           "    ws.send(b.buffer);\n"
+           "  } else doRequest(this.id, this.pressed + ',' + this.posx + ',' + this.posy, nomerge ? 2 : 1);\n"
            "}\n"
            "\n"
            // TODO: This should be customizable
@@ -121,26 +154,45 @@ public:
            "elem.addEventListener('touchend', function(event) { this.release(event.touches[0].offsetX, event.touches[0].offsetY); }.bind(elem), false);\n"
            "</script>\n");
     }
-    void updateFromDriverArg(const char* argname) {
-        const int bufsize = 16;
-        char buf[bufsize];
-        _driver->getArg(argname, buf, bufsize);
-        // format: "P,X,Y", each a number. Parsing from reverse
-        int p = bufsize;
-        while (--p >= 0) if (buf[p] == '\0') break;
-        while (--p >= 0) if (buf[p] == ',') break;
-        _cury = atoi(buf + p + 1);
-        buf[p] = '\0';
-        while (--p >= 0) if (buf[p] == ',') break;
-        _curx = atoi(buf + p + 1);
-        buf[p] = '\0';
-        _pressed = atoi(buf);
+    void updateFromDriverArg(const char* argname) override {
+        char buf[16];
+        const char* p = _driver->getArg(argname, buf, sizeof(buf));
+        // format: "P,X,Y", each a number
+        int vals[3] = {0, 0, 0};
+        uint8_t n = 0;
+        bool neg = false;
+        for (; *p && n < 3; ++p) {
+            if (*p == ',') {
+                if (neg) vals[n] = -vals[n];
+                neg = false;
+                ++n;
+            } else if (*p == '-') {
+                neg = true;
+            } else if (*p >= '0' && *p <= '9' && vals[n] < 10000) {
+                vals[n] = vals[n] * 10 + (*p - '0');
+            }
+        }
+        if (n < 3 && neg) vals[n] = -vals[n];
+        _pressed = vals[0];
+        _curx = vals[1];
+        _cury = vals[2];
+        updateValueString();
+    }
+    bool updateFromBinary(const uint8_t* data, size_t len) override {
+        // format: X, Y (16 bit signed, little endian), P (8 bit)
+        if (len != 5) return false;
+        _curx = (int16_t) (data[0] | (data[1] << 8));
+        _cury = (int16_t) (data[2] | (data[3] << 8));
+        _pressed = data[4];
         updateValueString();
+        return true;
     }
     /** Get current x position. Position is returned as a value between -1000 and +1000 (center 0), independent of the size of the control. */
     int getX() const { return _curx; };
     /** Get current y position. Position is returned as a value between -1000 and +1000 (center 0), independent of the size of the control. */
     int getY() const { return _cury; };
+    /** @returns true, while the joystick is being held by the user. */
+    bool isPressed() const { return _pressed; };
     /** Set x/y position in the client(s). Range -1000 to +1000. */
     void setPosition (int x, int y) {
         if (x != _curx || y != _cury) {
@@ -158,6 +210,10 @@ public:
         if (which == EmbAJAXBase::Value) return _value;
         return EmbAJAXElement::value(which);
     }
+    bool valueIsPlain(uint8_t which = EmbAJAXBase::Value) const override {
+        if (which == EmbAJAXBase::Value) return true;
+        return EmbAJAXElement::valueIsPlain(which);
+    }
 private:
     void updateValueString() {
         itoa(_curx, _value, 10);
@@ -171,7 +227,8 @@ private:
     int _height;
     const char* _snap_back;
     const char* _position_adjust;
-    int _curx, _cury;
+    uint16_t _interval;
+    int16_t _curx, _cury;  // NOTE: 16 bits, so the value string will always fit
     bool _pressed;
 };
 
@@ -30,12 +30,24 @@
 #include "EmbAJAX.h"
 
 #include <ESPAsyncWebServer.h>
+#include <new>
 
 #define EmbAJAXOutputDriverWebServerClass AsyncWebServer
 
+/** Minimum delay (in ms) between two notifications pushed to WebSocket clients. See EmbAJAXOutputDriverESPAsync::setWebSocketEnabled() */
+#define EMBAJAX_PUSH_MIN_INTERVAL 20
+
+/** Maximum size (in bytes) of a request held in memory: The body of an HTTP request, or a WebSocket message arriving in several parts.
+ *  Larger requests are refused (WebSocket clients send them via HTTP, instead). See also EMBAJAX_MAX_REQUEST_SIZE. */
+#define EMBAJAX_ASYNC_MAX_REQUEST (2 * EMBAJAX_MAX_REQUEST_SIZE)
+
 /**  @brief Output driver implementation. This implementation works with ESPAsyncWebServer (https://github.com/me-no-dev/ESPAsyncWebServer).
  *   
  *   To use this class, you will have to include EmbAJAXOutputDriverESPAsync.h *before* EmbAJAX.h
+ *
+ *   Each request is handled in its own EmbAJAXOutputContext, so several responses may be generated at the same time, in different
+ *   tasks (see EmbAJAXOutputDriverBase::setContext()). The contexts are allocated on the heap, as they are too large for the stack of the
+ *   async TCP task (ESP32), or the system context (ESP8266), in which requests are handled.
  */
 class EmbAJAXOutputDriverESPAsync : public EmbAJAXOutputDriverBase {
 public:
@@ -44,36 +56,241 @@ public:
     EmbAJAXOutputDriverESPAsync(EmbAJAXOutputDriverWebServerClass *server) {
         EmbAJAXBase::setDriver(this);
         _server = server;
-        _request = 0;
     }
     void printHeader(bool html) override {
-        _response = _request->beginResponseStream(html ? "text/html" : "text/json");
+        RequestContext *ctx = current();
+        if (ctx->ws) return;
+        ctx->response = ctx->request->beginResponseStream(html ? "text/html" : "text/plain");
+        AsyncWebHeader* accept = ctx->request->getHeader("Accept-Encoding");
+        if (beginCompression(accept && accept->value().indexOf("gzip") >= 0)) ctx->response->addHeader("Content-Encoding", "gzip");
+        if (html && pageETag()) {
+            ctx->response->addHeader("ETag", pageETag());
+            ctx->response->addHeader("Cache-Control", "no-cache");
+        }
     }
-    void printContent(const char *content) override {
-        _response->print(content);
+    using EmbAJAXOutputDriverBase::printContent;
+    void printContent(const char *content, size_t len) override {
+        RequestContext *ctx = current();
+        if (ctx->ws) ctx->ws_reply.concat(content, len);
+        else ctx->response->write((const uint8_t*) content, len);
     }
     const char* getArg(const char* name, char* buf, int buflen) override {
-        _request->arg(name).toCharArray (buf, buflen);
-        return buf;
+        return current()->args.get(name, buf, buflen);
+    }
+    size_t getArgChunk(const char* name, size_t offset, char* buf, size_t buflen) override {
+        return current()->args.get(name, offset, buf, buflen);
+    }
+    /** Enable a WebSocket connection (on the same path as each page), in addition to regular AJAX requests. Over this,
+     *  the server will notify clients as soon as there are changes, so they do not have to wait for the next poll, and
+     *  clients send their requests without the overhead of a new HTTP request, each time. Clients that cannot connect
+     *  fall back to polling.
+     *
+     *  @note Must be called before installPage(). For changes to be pushed, you need to call loopHook() from your loop(). */
+    void setWebSocketEnabled(bool enabled = true) {
+        _use_ws = enabled;
+    }
+    bool hasPushTransport() const override {
+        return _use_ws;
     }
     void installPage(EmbAJAXPageBase *page, const char *path, void (*change_callback)()=0) override {
-        _server->on(path, [=](AsyncWebServerRequest* request) {
-             _request = request;
-             _response = 0;
-             if (_request->method() == HTTP_POST) {  // AJAX request
-                 page->handleRequest(change_callback);
-             } else {  // Page load
-                 page->printPage();
-             }
-             _request->send(_response);
-             _request = 0;
+        if (_metrics_path && !_metrics_installed) {
+            _server->on(_metrics_path, HTTP_GET, [=](AsyncWebServerRequest* request) {
+                withContext(request, [&](RequestContext* context) {
+                    setContext(context);
+                    printMetrics();
+                    setContext(0);
+                    request->send(context->response);
+                });
+            });
+            _metrics_installed = true;
+        }
+        if (_poll_path) {
+            if (!_poll_installed) {
+                _server->on(_poll_path, HTTP_POST, [=](AsyncWebServerRequest* request) {
+                    withContext(request, [&](RequestContext* context) {
+                        if (!parseBody(context)) return;
+                        setContext(context);
+                        handlePoll();
+                        setContext(0);
+                        request->send(context->response);
+                    });
+                }, nullptr, collectBody);
+                _poll_installed = true;
+            }
+            addPolledPage(page);
+        }
+        if (_use_ws) {
+            // NOTE: Must be added before the regular page handler, as that would otherwise catch the WebSocket handshake on the same path
+            PushSocket *ws = new PushSocket(path, _sockets);
+            auto handleText = [=](AsyncWebSocketClient* client, const char* text, size_t len) {
+                withContext(0, [&](RequestContext* context) {
+                    context->ws = true;
+                    if (!context->args.parse(text, len)) return;  // encoded just like the body of a regular request ("id=x&value=y&...")
+                    setContext(context);
+                    page->handleRequest(change_callback);
+                    setContext(0);
+                    client->text(context->ws_reply);
+                });
+            };
+            ws->socket.onEvent([=](AsyncWebSocket*, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len) {
+                if (type == WS_EVT_DISCONNECT) ws->dropPartial(client->id());
+                if (type != WS_EVT_DATA) return;
+                AwsFrameInfo *info = (AwsFrameInfo*) arg;
+                uint8_t opcode = (info->opcode == WS_CONTINUATION) ? info->message_opcode : info->opcode;
+                if (info->num == 0 && info->final && info->index == 0 && info->len == len) {  // complete message in one go (the usual case)
+                    if (opcode == WS_BINARY) page->handleBinary(data, len, change_callback);  // sample from a fast input element, no reply expected
+                    else if (opcode == WS_TEXT) handleText(client, (const char*) data, len);
+                    return;
+                }
+                if (opcode != WS_TEXT) return;  // binary samples are always short
+                // Larger messages arrive in several parts (per TCP segment, and/or per frame). Collect them, up to EMBAJAX_ASYNC_MAX_REQUEST.
+                PartialMessage *message = ws->partial(client->id());
+                if (info->num == 0 && info->index == 0) {  // start of a new message: discard any remains of an incomplete one
+                    message->data = "";
+                    message->overflow = false;
+                }
+                if (message->overflow || message->data.length() + len > EMBAJAX_ASYNC_MAX_REQUEST) message->overflow = true;
+                else message->data.concat((const char*) data, len);
+                if (!info->final || info->index + len != info->len) return;  // more to come
+                if (message->overflow) client->text("e");  // tell the client to send this via HTTP, instead
+                else handleText(client, message->data.c_str(), message->data.length());
+                ws->dropPartial(client->id());
+            });
+            _server->addHandler(&ws->socket);
+            _sockets = ws;
+        }
+        _server->on(path, HTTP_ANY, [=](AsyncWebServerRequest* request) {
+            withContext(request, [&](RequestContext* context) {
+                if (request->method() == HTTP_POST && !parseBody(context)) return;
+                setContext(context);
+                if (request->method() == HTTP_POST) {  // AJAX request
+                    page->handleRequest(change_callback);
+                } else {  // Page load
+                    AsyncWebHeader* inm = request->getHeader("If-None-Match");
+                    if (_page_etags && checkPageETag(page, inm ? inm->value().c_str() : 0)) {
+                        AsyncWebServerResponse *response = request->beginResponse(304);
+                        response->addHeader("ETag", pageETag());
+                        flush();
+                        setContext(0);
+                        request->send(response);
+                        return;
+                    }
+                    page->printPage();
+                }
+                setContext(0);
+                request->send(context->response);
+            });
+        }, nullptr, collectBody);
+    }
+    void installScript(const char *path = "/embajax.js") override {
+        _script_path = path;
+        _server->on(path, HTTP_GET, [=](AsyncWebServerRequest* request) {
+            withContext(request, [&](RequestContext* context) {
+                setContext(context);
+                context->response = request->beginResponseStream("text/javascript");
+                // The page references the script with its version appended, thus it is safe to cache it for as long as the browser wants
+                context->response->addHeader("Cache-Control", "public, max-age=31536000, immutable");
+                context->response->addHeader("ETag", String('"') + scriptVersion() + '"');
+                context->response->addHeader("Vary", "Accept-Encoding");
+                AsyncWebHeader* accept = request->getHeader("Accept-Encoding");
+                if (beginCompression(accept && accept->value().indexOf("gzip") >= 0)) context->response->addHeader("Content-Encoding", "gzip");
+                printScript();
+                flush();
+                setContext(0);
+                request->send(context->response);
+            });
         });
     }
-    void loopHook() override {};
+    void loopHook() override {
+        if (!_sockets || pendingRevision() == _pushed_revision) return;
+        if (millis() - _latest_push < EMBAJAX_PUSH_MIN_INTERVAL) return;
+        _latest_push = millis();
+        _pushed_revision = pendingRevision();
+        for (PushSocket *ws = _sockets; ws; ws = ws->next) {
+            ws->socket.cleanupClients();
+            ws->socket.textAll("p");
+        }
+    };
 private:
+    /** Per-request state, in addition to that of the base class. Arguments are looked up in args (the body of the request, or the
+     *  WebSocket message). For messages received via WebSocket, request is 0, and the reply is collected in ws_reply. */
+    struct RequestContext : public EmbAJAXOutputContext {
+        RequestContext(AsyncWebServerRequest *_request) : request(_request) {};
+        AsyncWebServerRequest *request;
+        AsyncResponseStream *response = 0;
+        bool ws = false;
+        EmbAJAXRequestArgs args;
+        String ws_reply;
+    };
+    RequestContext* current() {
+        return static_cast<RequestContext*>(context());
+    }
+    /** Call the given function with a new RequestContext for the given request (0 for WebSocket messages). The context is allocated on the
+     *  heap, and freed, afterwards. It is not needed beyond that, as the response stream keeps its own copy of the output. If there is not
+     *  enough memory, reply with an error, instead (or drop the WebSocket message). */
+    template<typename T> void withContext(AsyncWebServerRequest* request, T handler) {
+        RequestContext *context = new (std::nothrow) RequestContext(request);
+        if (!context) {
+            if (request) request->send(503);
+            return;
+        }
+        handler(context);
+        delete context;
+    }
+    /** Body handler for HTTP requests. The client sends its requests as application/octet-stream, which the server passes on, as is
+     *  (instead of splitting it into an allocated String for each argument). Collect it for parseBody(). The request frees it, when done. */
+    static void collectBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+        if (total > EMBAJAX_ASYNC_MAX_REQUEST) return;
+        if (index == 0) request->_tempObject = malloc(total);
+        if (request->_tempObject) memcpy((char*) request->_tempObject + index, data, len);
+    }
+    /** Make the body collected by collectBody() available to getArg(). If it is missing (too large), reply with an error instead.
+     *  @returns false in that case. */
+    static bool parseBody(RequestContext* ctx) {
+        size_t len = ctx->request->contentLength();
+        if ((len && !ctx->request->_tempObject) || !ctx->args.parse(len ? (const char*) ctx->request->_tempObject : "", len)) {
+            ctx->request->send(413);
+            return false;
+        }
+        return true;
+    }
+    /** A text message being received over WebSocket in several parts, see installPage() */
+    struct PartialMessage {
+        uint32_t client;
+        String data;
+        bool overflow;
+        PartialMessage* next;
+    };
+    struct PushSocket {
+        PushSocket(const char* path, PushSocket* _next) : socket(path), next(_next) {};
+        AsyncWebSocket socket;
+        PushSocket* next;
+        /** Messages being received, at most one per client. Only accessed from the task handling the socket. */
+        PartialMessage* partials = 0;
+        /** @returns the partial message of the given client, creating it, if needed. */
+        PartialMessage* partial(uint32_t client) {
+            for (PartialMessage* m = partials; m; m = m->next) {
+                if (m->client == client) return m;
+            }
+            partials = new PartialMessage { client, String(), false, partials };
+            return partials;
+        }
+        void dropPartial(uint32_t client) {
+            for (PartialMessage** m = &partials; *m; m = &(*m)->next) {
+                if ((*m)->client == client) {
+                    PartialMessage* dropped = *m;
+                    *m = dropped->next;
+                    delete dropped;
+                    return;
+                }
+            }
+        }
+    };
     EmbAJAXOutputDriverWebServerClass *_server;
-    AsyncWebServerRequest *_request;
-    AsyncResponseStream *_response;
+    bool _use_ws = false;
+    PushSocket *_sockets = 0;
+    uint32_t _pushed_revision = 0;
+    unsigned long _latest_push = 0;
 };
 
 typedef EmbAJAXOutputDriverESPAsync EmbAJAXOutputDriver;
@@ -44,34 +44,129 @@ public:
         _server = server;
     }
     void printHeader(bool html) override {
-        _server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+        bool gzip = beginCompression(_server->header("Accept-Encoding").indexOf("gzip") >= 0);
+        if (gzip) _server->sendHeader("Content-Encoding", "gzip");
+        _server->setContentLength((contentLength() && !gzip) ? contentLength() : CONTENT_LENGTH_UNKNOWN);
         if (html) {
+            if (pageETag()) {
+                _server->sendHeader("ETag", pageETag());
+                _server->sendHeader("Cache-Control", "no-cache");
+            }
             _server->send(200, "text/html", "");
         } else {
-            _server->send(200, "text/json", "");
+            _server->send(200, "text/plain", "");
         }
     }
-    void printContent(const char *content) override {
-        if (content[0] != '\0') _server->sendContent(content);  // NOTE: There seems to be a bug in the ESP8266 server when sending empty string.
+    using EmbAJAXOutputDriverBase::printContent;
+    void printContent(const char *content, size_t len) override {
+        _server->sendContent(content, len);
     }
     const char* getArg(const char* name, char* buf, int buflen) override {
+        if (_args) return _args->get(name, buf, buflen);
         _server->arg(name).toCharArray (buf, buflen);
         return buf;
     }
+    size_t getArgChunk(const char* name, size_t offset, char* buf, size_t buflen) override {
+        if (_args) return _args->get(name, offset, buf, buflen);
+        // NOTE: Depending on the server, arg() returns a reference to the value (no copy), or a copy
+        const String& value = _server->arg(name);
+        if (offset >= value.length()) return 0;
+        size_t len = value.length() - offset;
+        if (len > buflen) len = buflen;
+        memcpy(buf, value.c_str() + offset, len);
+        return len;
+    }
+    /** If enabled, each response is generated twice: First to determine its exact length, only, then to actually send it. This allows
+     *  sending a Content-Length header, instead of using chunked transfer encoding, at the cost of some processing time. Disabled by default. */
+    void setPrecomputeContentLength(bool enabled = true) {
+        _precompute_length = enabled;
+    }
+    /** See EmbAJAXOutputDriverBase::setCompressionEnabled().
+     *  @note This needs to know the Accept-Encoding header of requests. As the server will only collect headers that have been explicitly
+     *        asked for, this calls collectHeaders(), and will thus replace any headers that you may have requested, yourself. */
+    bool setCompressionEnabled(bool enabled = true) override {
+        if (enabled) collectHeaders();
+        return EmbAJAXOutputDriverBase::setCompressionEnabled(enabled);
+    }
+    /** See EmbAJAXOutputDriverBase::setPageETagsEnabled().
+     *  @note This needs to know the If-None-Match header of requests, and calls collectHeaders(), like setCompressionEnabled(). */
+    void setPageETagsEnabled(bool enabled = true) override {
+        if (enabled) collectHeaders();
+        EmbAJAXOutputDriverBase::setPageETagsEnabled(enabled);
+    }
     void installPage(EmbAJAXPageBase *page, const char *path, void (*change_callback)()=0) override {
+        if (_metrics_path && !_metrics_installed) {
+            _server->on(_metrics_path, [=]() {
+                printMetrics();
+            });
+            _metrics_installed = true;
+        }
+        if (_poll_path) {
+            if (!_poll_installed) {
+                _server->on(_poll_path, [=]() {
+                    withRequestArgs([=]() { handlePoll(); });
+                });
+                _poll_installed = true;
+            }
+            addPolledPage(page);
+        }
         _server->on(path, [=]() {
              if (_server->method() == HTTP_POST) {  // AJAX request
-                 page->handleRequest(change_callback);
+                 withRequestArgs([=]() { page->handleRequest(change_callback); });
              } else {  // Page load
+                 if (_page_etags && checkPageETag(page, _server->header("If-None-Match").c_str())) {
+                     _server->sendHeader("ETag", pageETag());
+                     _server->send(304);
+                     flush();
+                     return;
+                 }
                  page->printPage();
              }
         });
     }
+    void installScript(const char *path = "/embajax.js") override {
+        _script_path = path;
+        _server->on(path, [=]() {
+            // The page references the script with its version appended, thus it is safe to cache it for as long as the browser wants
+            _server->sendHeader("Cache-Control", "public, max-age=31536000, immutable");
+            _server->sendHeader("ETag", String('"') + scriptVersion() + '"');
+            _server->sendHeader("Vary", "Accept-Encoding");
+            bool gzip = beginCompression(_server->header("Accept-Encoding").indexOf("gzip") >= 0);
+            if (gzip) _server->sendHeader("Content-Encoding", "gzip");
+            _server->setContentLength(gzip ? CONTENT_LENGTH_UNKNOWN : scriptLength());
+            _server->send(200, "text/javascript", "");
+            printScript();
+            flush();
+        });
+    }
     void loopHook() override {
         _server->handleClient();
     };
 private:
+    /** Call the given function with the arguments of the current request made available to getArg(). The client sends its request body as
+     *  application/octet-stream, which the server keeps as a single argument, instead of splitting it into an allocated String for each name and value.
+     *  Arguments are then looked up in that, directly. Requests too large for this are refused. */
+    template<typename T> void withRequestArgs(T handler) {
+        EmbAJAXRequestArgs args;
+        const String& body = _server->arg("plain");
+        if (body.length()) {
+            if (!args.parse(body.c_str(), body.length())) {
+                _server->send(413, "text/plain", "");
+                return;
+            }
+            _args = &args;
+        }
+        handler();
+        _args = 0;
+    }
+    /** Ask the server to keep all request headers looked at in this driver */
+    void collectHeaders() {
+        static const char* headers[] = { "Accept-Encoding", "If-None-Match" };
+        _server->collectHeaders(headers, 2);
+    }
     EmbAJAXOutputDriverWebServerClass *_server;
+    /** Arguments of the request being handled, if available as a whole, see withRequestArgs() */
+    EmbAJAXRequestArgs *_args = 0;
 };
 
 typedef EmbAJAXOutputDriverGeneric EmbAJAXOutputDriver;
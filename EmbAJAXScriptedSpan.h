@@ -35,7 +35,8 @@
  * 
  * If the scripted object allows the user to make changes, the script should call
  * "this.sendValue(value);", when the value has changed. You will also have to set a
- * large enough receive buffer in the constructor in this case!
+ * large enough receive buffer in the constructor in this case! Alternatively, large values
+ * can be received in chunks, see setReceiveHandler().
  * 
  * @warning This class is new, and its API may not be quite stable at the time of this
  *          writing. Feedback welcome.
@@ -55,6 +56,12 @@ public:
         _script = script;
         _rec_buffer = rec_buffer;
         _rec_buffer_size = rec_buffer_size;
+        _skip_unchanged = false;
+        _checksum = 0;
+        _receive_handler = 0;
+        _part_size = 0;
+        _next_part = 0;
+        _received = 0;
     }
     void print() const override {
         _driver->printFormatted("<span id=", HTML_QUOTED_STRING(_id), "><script>{\n"
@@ -66,8 +73,27 @@ public:
                               "})\n"
                               "spn.sendValue = function(value) {\n"
                               "  doRequest(this.id, value);\n"
-                              "}\n"
-                              "spn.init=function() {\n",
+                              "}\n");
+        if (_part_size) {
+            // Replaces the above: Split into parts of at most _part_size bytes (once url-encoded), each prefixed with its number, and ':', or '.'
+            // for the last one. Surrogate pairs (e.g. emoji) are kept together, as they cannot be encoded, separately. See receiveChunks()
+            _driver->printFormatted("spn.sendValue = function(value) {\n"
+                                  "  value = String(value);\n"
+                                  "  var i = 0, pos = 0;\n"
+                                  "  do {\n"
+                                  "    var end = pos, size = 0;\n"
+                                  "    while (end < value.length) {\n"
+                                  "      var n = ((value.charCodeAt(end) & 0xFC00) == 0xD800) ? 2 : 1;\n"
+                                  "      var s = encodeURIComponent(value.substr(end, n)).length;\n"
+                                  "      if (end > pos && size + s > ", INTEGER_VALUE(_part_size), ") break;\n"
+                                  "      size += s; end += n;\n"
+                                  "    }\n"
+                                  "    doRequest(this.id, (i++) + (end >= value.length ? '.' : ':') + value.substring(pos, end), 3);\n"
+                                  "    pos = end;\n"
+                                  "  } while (pos < value.length);\n"
+                                  "}\n");
+        }
+        _driver->printFormatted("spn.init=function() {\n",
                               PLAIN_STRING(_script),
                               "\n};\n"
                               "spn.init();\n"
@@ -86,10 +112,10 @@ public:
      *  often, the client will probably not see every value. It will only get to see
      *  the latest value that was set on each poll.
      * 
-     *  Further note that as of this writing, EmbAJAX does not check whether the value
+     *  Further note that by default, EmbAJAX does not check whether the value
      *  is actually changed, when you call this. You can avoid network overhead by
-     *  making sure to call setValue(), only when something has actually changed. This
-     *  may be changed in a future version of EmbAJAX.
+     *  making sure to call setValue(), only when something has actually changed, or
+     *  by enabling setSkipUnchanged(). See also setPublishInterval().
      * 
      *  For safety, the value string is always quoted when sending it to the client. This
      *  is not a problem as long as you are sending strings or plain numbers. To send more
@@ -98,20 +124,99 @@ public:
      *
      *  @param value: Note: The string is not copied, so don't make this a temporary. */
     void setValue(const char* value) {
-        // TODO: Check whether the value has actually changed
+        if (_skip_unchanged) {
+            uint32_t sum = checksum(value);
+            _value = value;  // The pointer may have changed, even if the content has not
+            if (sum == _checksum) return;
+            _checksum = sum;
+        }
         _value = value;
         setChanged();
     };
+    /** If enabled, setValue() will keep a checksum of the value, and ignore calls that do not actually change the content.
+     *  See EmbAJAXMutableSpan::setSkipUnchanged() for details. */
+    void setSkipUnchanged(bool skip = true) {
+        _skip_unchanged = skip;
+        _checksum = checksum(_value);
+    }
     
+    /** Handler for values received in chunks, see setReceiveHandler().
+     *  @param chunk the chunk, not 0-terminated
+     *  @param len length of the chunk
+     *  @param offset position of the chunk within the value. 0 for the first chunk of a new value.
+     *  @param complete true, if this is the final chunk of the value */
+    typedef void (*ReceiveHandler)(const char* chunk, size_t len, size_t offset, bool complete);
+    /** Receive values sent from the client in chunks of (at most) the size of the receive buffer passed in the constructor, instead
+     *  of copying the whole value to that buffer. This allows receiving values of any size (e.g. a configuration file), without
+     *  reserving RAM for the whole value, anywhere. Further, the client will split values into parts of (at most) part_size
+     *  bytes, sent in separate requests (see EMBAJAX_MAX_REQUEST_SIZE), so that the server does not have to hold a really large request,
+     *  either.
+     *
+     *  The value of the span, itself, is not touched by this. If any part of a value goes missing (e.g. due to a lost connection),
+     *  the remainder of that value is discarded, i.e. the handler will not be called with complete set.
+     *
+     *  @note The part size is used on the client, so clients that have already loaded the page will have to reload it.
+     *  @param handler the function to call for each chunk. 0 to disable.
+     *  @param part_size maximum size of each part sent by the client (in bytes, once url-encoded). Limited to somewhat below
+     *                   EMBAJAX_MAX_REQUEST_SIZE, such that a request carrying a part, along with other changes, is not refused by the server. */
+    void setReceiveHandler(ReceiveHandler handler, uint16_t part_size = 256) {
+        _receive_handler = handler;
+        if (part_size > MaxPartSize) part_size = MaxPartSize;
+        _part_size = handler ? part_size : 0;
+        if (_driver) _driver->setStructureChanged();  // part size is used in the page
+    }
+
     void updateFromDriverArg(const char* argname) override {
+        if (_receive_handler) {
+            receiveChunks(argname);
+            return;
+        }
         _driver->getArg(argname, _rec_buffer, _rec_buffer_size);
         _value = _rec_buffer;
+        if (_skip_unchanged) _checksum = checksum(_value);
     }
 private:
+    enum {
+        // The client sends changes in one request, as long as below EMBAJAX_MAX_REQUEST_SIZE, i.e. a part may be added to almost that much. Leave
+        // room for the remaining arguments (client, revision, argument names). The decoded part (never larger) then also fits EMBAJAX_MAX_ARG_SCRATCH.
+        MaxPartSize = EMBAJAX_MAX_REQUEST_SIZE - 128
+    };
+    void receiveChunks(const char* argname) {
+        if (!_rec_buffer_size) return;
+        // Each part is prefixed by its number, and ':', or '.' for the final part of the value
+        char head[12];
+        size_t len = _driver->getArgChunk(argname, 0, head, sizeof(head));
+        size_t pos = 0;
+        uint16_t part = 0;
+        while (pos < len && isdigit(head[pos])) part = part * 10 + (head[pos++] - '0');
+        if (pos == 0 || pos >= len || (head[pos] != ':' && head[pos] != '.')) return;
+        bool last = (head[pos++] == '.');
+        if (part == 0) _received = 0;
+        else if (part != _next_part) {  // missed a part: discard the rest of this value
+            _next_part = 0;
+            return;
+        }
+        _next_part = last ? 0 : part + 1;
+
+        while (true) {
+            len = _driver->getArgChunk(argname, pos, _rec_buffer, _rec_buffer_size);
+            pos += len;
+            bool end = len < _rec_buffer_size;
+            if (len || (end && last)) _receive_handler(_rec_buffer, len, _received, end && last);
+            _received += len;
+            if (end) break;
+        }
+    }
     const char* _value;
+    bool _skip_unchanged;
+    uint32_t _checksum;
     const char* _script;
     char* _rec_buffer;
     size_t _rec_buffer_size;
+    ReceiveHandler _receive_handler;
+    uint16_t _part_size;
+    uint16_t _next_part;
+    size_t _received;
 };
 
 #endif
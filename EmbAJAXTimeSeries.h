@@ -0,0 +1,181 @@
+/*
+ *
+ * EmbAJAX - Simplistic framework for creating and handling displays and controls on a WebPage served by an Arduino (or other small device).
+ *
+ * Copyright (C) 2018-2023 Thomas Friedrichsmeier
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+*/
+
+#ifndef EMBAJAXTIMESERIES_H
+#define EMBAJAXTIMESERIES_H
+
+#include "EmbAJAX.h"
+
+/** Number of revisions to remember the position in the sample stream for, in each EmbAJAXTimeSeries (8 bytes each). Clients lagging further
+ *  behind than this will be sent the full history, instead of just the new samples. */
+#define EMBAJAX_TIMESERIES_MARKS 8
+
+/** @brief A plot of the most recent SIZE values of a time series, e.g. a sensor reading
+ *
+ *  Samples are kept in a ring buffer of the given SIZE, on the server. Other than for most elements, only the samples added since the
+ *  client's last update are sent, in each update (or the full history for new and lagging clients, see EMBAJAX_TIMESERIES_MARKS).
+ *  The client keeps its own copy of the series, and draws it as a simple line plot (autoscaled) on a <canvas>.
+ *
+ *  Samples are 16 bit integers, to keep the footprint small. For fractional values, scale the values as appropriate, and pass the
+ *  scaling factor as divisor. It is used for the axis labels on the client.
+ *
+ *  Combine with setPublishInterval() when adding samples at a high rate: All samples are still sent, but batched.
+ *
+ *  @warning This class is new, and its API may not be quite stable at the time of this writing. Feedback welcome. */
+template<size_t SIZE> class EmbAJAXTimeSeries : public EmbAJAXElement {
+public:
+    /** @param width width of the plot in pixels
+     *  @param height height of the plot in pixels
+     *  @param divisor sample values will be divided by this for display on the client */
+    EmbAJAXTimeSeries(const char* id, int width, int height, uint16_t divisor = 1) : EmbAJAXElement(id) {
+        _width = width;
+        _height = height;
+        _divisor = divisor;
+        _total = 0;
+        _first = 0;
+        _num_marks = 0;
+        _floor = 0;
+    }
+    void print() const override {
+        _driver->printFormatted("<canvas id=", HTML_QUOTED_STRING(_id), " width=", INTEGER_VALUE(_width), " height=", INTEGER_VALUE(_height), "></canvas><script>{\n"
+                              "let cnv=document.getElementById(", JS_QUOTED_STRING(_id), ");\n"
+                              "cnv.series=[]; cnv.next=0;\n"
+                              "Object.defineProperty(cnv, 'EmbAJAXSamples', {\n"
+                              "  set: function(value) {\n"   // [r|a]first_seq:v1,v2,...
+                              "    var p=value.indexOf(':');\n"
+                              "    var seq=+value.substring(1, p);\n"
+                              "    var vals=(p+1 < value.length) ? value.substring(p+1).split(',').map(Number) : [];\n"
+                              "    var end=seq+vals.length;\n"
+                              "    if (value[0]=='r' || seq > this.next || end < this.next) this.series=[];\n"  // full history, or we missed something
+                              "    else vals=vals.slice(this.next-seq);\n"  // skip samples we have, already
+                              "    this.series=this.series.concat(vals).slice(-", INTEGER_VALUE(SIZE), ");\n"
+                              "    this.next=end;\n"
+                              "    this.draw();\n"
+                              "  }\n"
+                              "});\n"
+                              "cnv.draw=function() {\n"
+                              "  var c=this.getContext('2d'), s=this.series, w=this.width, h=this.height;\n"
+                              "  c.clearRect(0, 0, w, h);\n"
+                              "  if (!s.length) return;\n"
+                              "  var lo=Math.min(...s), hi=Math.max(...s);\n"
+                              "  if (hi == lo) { --lo; ++hi; }\n"
+                              "  c.beginPath();\n"
+                              "  for (var i=0; i < s.length; ++i) c.lineTo(i*w/", INTEGER_VALUE(SIZE > 1 ? SIZE - 1 : 1), ", h-(s[i]-lo)*h/(hi-lo));\n"
+                              "  c.stroke();\n"
+                              "  c.fillText(hi/", INTEGER_VALUE(_divisor), ", 2, 10);\n"
+                              "  c.fillText(lo/", INTEGER_VALUE(_divisor), ", 2, h-2);\n"
+                              "}\n"
+                              "}</script>\n");
+    }
+    const char* value(uint8_t which = EmbAJAXBase::Value) const override {
+        if (which == EmbAJAXBase::Value) return EmbAJAXBase::null_string;  // Not used, see printValue()
+        return EmbAJAXElement::value(which);
+    }
+    const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override {
+        if (which == EmbAJAXBase::Value) return "EmbAJAXSamples";
+        return EmbAJAXElement::valueProperty(which);
+    }
+    bool printValue(uint8_t which, uint32_t since, EmbAJAXOutputDriverBase::QuoteMode quoted) const override {
+        if (which != EmbAJAXBase::Value) return false;
+
+        _driver->lock();
+        bool full = (since == 0 || since <= _floor);
+        uint32_t start = _first;
+        if (!full) {
+            // Find the first sample added at or after the client's revision (added at that revision, it may or may not have been sent, yet)
+            start = _total;
+            for (uint8_t i = 0; i < _num_marks; ++i) {
+                if (_marks[i].revision >= since) {
+                    start = _marks[i].seq;
+                    break;
+                }
+            }
+            if (start < _first) start = _first;
+        }
+        uint32_t end = _total;
+        _driver->unlock();
+
+        // NOTE: Samples are not copied, and printed without holding the lock. Should SIZE samples get added while we are printing, some
+        //       values may be newer than their sequence number says. That's harmless, the next update will correct the plot.
+        if (quoted == EmbAJAXOutputDriverBase::JSQuoted) _driver->printContent("\"");
+        _driver->printContent(full ? "r" : "a");
+        _driver->printInteger(start);
+        _driver->printContent(":");
+        for (uint32_t seq = start; seq < end; ++seq) {
+            if (seq != start) _driver->printContent(",");
+            _driver->printInteger(_samples[seq % SIZE]);
+        }
+        if (quoted == EmbAJAXOutputDriverBase::JSQuoted) _driver->printContent("\"");
+        return true;
+    }
+    /** Add a sample to the series. If the buffer is full, the oldest sample is dropped. */
+    void addSample(int16_t value) {
+        _driver->lock();
+        // Remember where the samples added at this revision begin, so clients can be sent only what they are missing
+        uint32_t rev = _driver->revision();
+        if (!_num_marks || _marks[_num_marks-1].revision != rev) {
+            if (_num_marks == EMBAJAX_TIMESERIES_MARKS) {
+                _floor = _marks[0].revision;
+                memmove(_marks, _marks + 1, sizeof(_marks[0]) * (EMBAJAX_TIMESERIES_MARKS - 1));
+                --_num_marks;
+            }
+            _marks[_num_marks].revision = rev;
+            _marks[_num_marks].seq = _total;
+            ++_num_marks;
+        }
+        _samples[_total % SIZE] = value;
+        ++_total;
+        if (_total - _first > SIZE) _first = _total - SIZE;
+        _driver->unlock();
+        setChanged();
+    }
+    /** Remove all samples. */
+    void clear() {
+        _driver->lock();
+        _first = _total;
+        _num_marks = 0;
+        _floor = _driver->revision();  // Clients at this revision, or below, will need a full update
+        _driver->unlock();
+        setChanged();
+    }
+    /** @returns the number of samples currently held (at most SIZE). */
+    size_t count() const {
+        return _total - _first;
+    }
+private:
+    int16_t _samples[SIZE];
+    /** Number of samples added in total, i.e. the sequence number of the next sample */
+    uint32_t _total;
+    /** Sequence number of the oldest sample held */
+    uint32_t _first;
+    struct {
+        uint32_t revision;
+        uint32_t seq;
+    } _marks[EMBAJAX_TIMESERIES_MARKS];
+    uint8_t _num_marks;
+    /** Clients at this revision, or below, cannot be sent a delta */
+    uint32_t _floor;
+    int _width;
+    int _height;
+    uint16_t _divisor;
+};
+
+#endif
@@ -49,6 +49,7 @@ public:
     /** Set a placeholder text (will be shown, when the input is empty) */
     void setPlaceholder(const char* placeholder) {
         _placeholder = placeholder;
+        if (EmbAJAXBase::_driver) EmbAJAXBase::_driver->setStructureChanged();
     }
     /** Set a placeholder text (will be shown, when the input is empty)
      * 
@@ -58,6 +59,7 @@ public:
      */
     void setPattern(const char* pattern) {
         _pattern = pattern;
+        if (EmbAJAXBase::_driver) EmbAJAXBase::_driver->setStructureChanged();
     }
     /** Specify custom attributes (other than placeholder and pattern)
      *  to be inserted in the \<input>-tag in the generated HTML.
@@ -68,6 +70,7 @@ public:
      */
     void setCustomValidationAttributes(const char* attributes) {
         _attributes = attributes;
+        if (EmbAJAXBase::_driver) EmbAJAXBase::_driver->setStructureChanged();
     }
 private:
     const char* _attributes;
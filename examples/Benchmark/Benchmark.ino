@@ -0,0 +1,166 @@
+/* Benchmark for EmbAJAX: Measures the time needed for rendering pages, handling requests, looking up elements, and
+ * escaping strings, for pages of different sizes. No network connection is needed (or used): Output is counted, and
+ * discarded by a dummy output driver (see BenchmarkDriver.h). Results are printed to Serial:
+ *
+ *   test, parameter (number of elements / nesting depth / string length), time per operation (ns), bytes of output per operation,
+ *   calls to printContent() per operation
+ *
+ * The absolute numbers will obviously depend on your MCU. The point is comparing different settings (e.g. EMBAJAX_OUTPUT_BUFFER_SIZE,
+ * or EMBAJAX_CHANGE_RING_SIZE), or versions of EmbAJAX, on the same hardware. For quick comparisons, the benchmark can also be built and
+ * run on a PC, see host/Makefile.
+ *
+ * This example code is in the public domain (CONTRARY TO THE LIBRARY ITSELF). */
+
+#include "BenchmarkDriver.h"
+
+// Minimum time to spend on each test (microseconds)
+#define BENCH_TIME 500000
+
+#if defined(__AVR__)
+#define SMALL_PAGE 5
+#define MEDIUM_PAGE 10
+#define LARGE_PAGE 20
+#else
+#define SMALL_PAGE 10
+#define MEDIUM_PAGE 100
+#define LARGE_PAGE 500
+#endif
+#define MAX_DEPTH 16
+
+BenchmarkDriver driver;
+
+EmbAJAXBase* small_elements[SMALL_PAGE];
+EmbAJAXPage<SMALL_PAGE> small_page(small_elements, "Benchmark");
+EmbAJAXBase* medium_elements[MEDIUM_PAGE];
+EmbAJAXPage<MEDIUM_PAGE> medium_page(medium_elements, "Benchmark");
+EmbAJAXBase* large_elements[LARGE_PAGE];
+EmbAJAXPage<LARGE_PAGE> large_page(large_elements, "Benchmark");
+
+// Fill a page with a mix of sliders (id s0, s2, ...), and spans (id d1, d3, ...)
+void fillPage(EmbAJAXBase** elements, size_t num) {
+  for (size_t i = 0; i < num; ++i) {
+    char* id = new char[8];
+    id[0] = (i % 2) ? 'd' : 's';
+    itoa(i, id + 1, 10);
+    if (i % 2) {
+      EmbAJAXMutableSpan* span = new EmbAJAXMutableSpan(id);
+      span->setValue("Some <b>text</b> & \"quotes\"");
+      elements[i] = span;
+    } else {
+      elements[i] = new EmbAJAXSlider(id, 0, 1000, i);
+    }
+  }
+}
+
+// Currently benchmarked objects, for the functions below
+EmbAJAXPageBase* page;
+EmbAJAXBase* container;
+char request[64];
+char text[1024];
+
+void printPage() {
+  page->printPage();
+}
+
+void handleRequest() {
+  page->handleRequest();
+}
+
+// A client sending a change, while it is up to date, otherwise. Since each change is a new revision, the request is built anew, each
+// time (or the client would soon lag behind by more than EMBAJAX_CHANGE_RING_SIZE changes). Alternates between two values.
+void handleChange() {
+  static bool odd = false;
+  odd = !odd;
+  strcpy(request, odd ? "id=s0&value=5&revision=" : "id=s0&value=6&revision=");
+  ultoa(driver.revision(), request + strlen(request), 10);
+  driver.setRequest(request);
+  page->handleRequest();
+}
+
+void findChild() {
+  container->findChild("deep");
+}
+
+void printFiltered() {
+  driver.printFiltered(text, EmbAJAXOutputDriverBase::JSQuoted, true);
+}
+
+// Run func() repeatedly, for at least BENCH_TIME, and print the average time per call, along with the average amount of output generated
+void bench(const char* name, long param, void (*func)()) {
+  func();  // warm-up run, e.g. building the index of each page
+  driver.flush();
+
+  driver.resetCounters();
+  unsigned long runs = 0;
+  unsigned long start = micros();
+  unsigned long elapsed;
+  do {
+    func();
+    driver.flush();
+    ++runs;
+    elapsed = micros() - start;
+    yield();
+  } while (elapsed < BENCH_TIME);
+
+  Serial.print(name);
+  Serial.print('\t');
+  Serial.print(param);
+  Serial.print('\t');
+  Serial.print((elapsed / runs) * 1000 + ((elapsed % runs) * 1000) / runs);
+  Serial.print(" ns/op\t");
+  Serial.print(driver.bytes / runs);
+  Serial.print(" bytes\t");
+  Serial.print(driver.calls / runs);
+  Serial.println(" calls");
+}
+
+void benchPage(EmbAJAXPageBase* p, EmbAJAXBase* c, long num) {
+  page = p;
+  container = c;
+
+  bench("printPage", num, printPage);
+  bench("findChild (flat, missing)", num, findChild);
+
+  strcpy(request, "revision=0");
+  driver.setRequest(request);
+  bench("handleRequest (full update)", num, handleRequest);
+
+  strcpy(request, "revision=");
+  ultoa(driver.revision(), request + strlen(request), 10);
+  driver.setRequest(request);
+  bench("handleRequest (no changes)", num, handleRequest);
+
+  bench("handleRequest (one change)", num, handleChange);
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  fillPage(small_elements, SMALL_PAGE);
+  fillPage(medium_elements, MEDIUM_PAGE);
+  fillPage(large_elements, LARGE_PAGE);
+
+  Serial.println("test\tparameter\ttime\toutput\tprintContent()");
+  benchPage(&small_page, &small_page, SMALL_PAGE);
+  benchPage(&medium_page, &medium_page, MEDIUM_PAGE);
+  benchPage(&large_page, &large_page, LARGE_PAGE);
+
+  // findChild() through nested containers
+  container = new EmbAJAXSlider("deep", 0, 1000, 0);
+  for (int depth = 1; depth <= MAX_DEPTH; ++depth) {
+    EmbAJAXBase** children = new EmbAJAXBase*[1];
+    children[0] = container;
+    container = new EmbAJAXContainer<1>(children);
+    if ((depth & (depth - 1)) == 0) bench("findChild (nested)", depth, findChild);
+  }
+
+  // Escaping, without and with characters to escape
+  memset(text, 'a', sizeof(text) - 1);
+  text[sizeof(text) - 1] = '\0';
+  bench("printFiltered (plain)", sizeof(text) - 1, printFiltered);
+  for (size_t i = 0; i < sizeof(text) - 1; i += 8) text[i] = (i % 16) ? '<' : '"';
+  bench("printFiltered (escaped)", sizeof(text) - 1, printFiltered);
+}
+
+void loop() {
+}
@@ -0,0 +1,54 @@
+/* Output driver for the Benchmark example: Does not talk to any server, at all. Output is counted (bytes, and calls to
+ * printContent()), and discarded. Requests are "received" from a string set with setRequest().
+ *
+ * This example code is in the public domain (CONTRARY TO THE LIBRARY ITSELF). */
+
+#ifndef BENCHMARKDRIVER_H
+#define BENCHMARKDRIVER_H
+
+#define EMBAJAX_OUTUPUTDRIVER_IMPLEMENTATION
+#include <EmbAJAX.h>
+
+class BenchmarkDriver : public EmbAJAXOutputDriverBase {
+public:
+    BenchmarkDriver() {
+        EmbAJAXBase::setDriver(this);
+    }
+    void printHeader(bool html) override {
+        (void) html;
+    }
+    using EmbAJAXOutputDriverBase::printContent;
+    void printContent(const char *content, size_t len) override {
+        (void) content;
+        bytes += len;
+        ++calls;
+    }
+    const char* getArg(const char* name, char* buf, int buflen) override {
+        return _args.get(name, buf, buflen);
+    }
+    size_t getArgChunk(const char* name, size_t offset, char* buf, size_t buflen) override {
+        return _args.get(name, offset, buf, buflen);
+    }
+    void installPage(EmbAJAXPageBase *page, const char *path, void (*change_callback)()=0) override {
+        (void) page;
+        (void) path;
+        (void) change_callback;
+    }
+    void loopHook() override {};
+
+    /** Set the (url-encoded) body of the request to be handled by the next call(s) to handleRequest(). Not copied. */
+    void setRequest(const char* body) {
+        _args.parse(body, strlen(body));
+    }
+    /** Reset the output counters */
+    void resetCounters() {
+        bytes = 0;
+        calls = 0;
+    }
+    unsigned long bytes = 0;
+    unsigned long calls = 0;
+private:
+    EmbAJAXRequestArgs _args;
+};
+
+#endif
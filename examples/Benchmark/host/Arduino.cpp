@@ -0,0 +1,55 @@
+/* See Arduino.h in this directory.
+ *
+ * This example code is in the public domain (CONTRARY TO THE LIBRARY ITSELF). */
+
+#include "Arduino.h"
+#include <chrono>
+#include <thread>
+
+static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+unsigned long micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+}
+
+char* ultoa(unsigned long value, char* buf, int base) {
+    char rev[8 * sizeof(value) + 1];
+    int n = 0;
+    do {
+        rev[n++] = "0123456789abcdefghijklmnopqrstuvwxyz"[value % base];
+        value /= base;
+    } while (value);
+    int i = 0;
+    while (n) buf[i++] = rev[--n];
+    buf[i] = '\0';
+    return buf;
+}
+
+char* itoa(int value, char* buf, int base) {
+    if (value < 0 && base == 10) {
+        buf[0] = '-';
+        ultoa(-(long) value, buf + 1, base);
+    } else {
+        ultoa((unsigned int) value, buf, base);
+    }
+    return buf;
+}
+
+HostSerial Serial;
+
+// Unlike on an MCU, loop() is never called: The Benchmark does all its work in setup().
+int main() {
+    setup();
+    return 0;
+}
@@ -0,0 +1,48 @@
+/* Minimal mock of the Arduino API, just enough to build the Benchmark example on a PC (see Makefile in this directory). This is not a
+ * general purpose emulation: There is no network, and timing is taken from the host's steady clock.
+ *
+ * This example code is in the public domain (CONTRARY TO THE LIBRARY ITSELF). */
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <algorithm>
+
+typedef uint8_t byte;
+using std::min;
+using std::max;
+
+#define memcpy_P memcpy
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+char* itoa(int value, char* buf, int base);
+char* ultoa(unsigned long value, char* buf, int base);
+
+/** Prints to stdout */
+class HostSerial {
+public:
+    void begin(unsigned long baud) { (void) baud; }
+    void print(const char* value) { fputs(value, stdout); }
+    void print(char value) { putchar(value); }
+    void print(int value) { printf("%d", value); }
+    void print(unsigned int value) { printf("%u", value); }
+    void print(long value) { printf("%ld", value); }
+    void print(unsigned long value) { printf("%lu", value); }
+    template<typename T> void println(T value) { print(value); println(); }
+    void println() { putchar('\n'); fflush(stdout); }
+};
+extern HostSerial Serial;
+
+// Provided by the sketch
+void setup();
+void loop();
+
+#endif
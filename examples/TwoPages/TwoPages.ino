@@ -41,6 +41,11 @@ void setup() {
   WiFi.softAPConfig (IPAddress (192,168,4,1), IPAddress (0,0,0,0), IPAddress (255,255,255,0));
   WiFi.softAP("EmbAJAXTest", "12345678");
 
+  // Both pages share the same client side script. Serve it separately, so the browser will only have to load it once.
+  driver.installScript();
+  // If both pages are open in the same browser, let only one of them poll the server for updates, on behalf of both.
+  driver.setPollPath();
+
   // Tell the server to serve the two pages at root, and at "/page2", respectively.
   // installPage() abstracts over the (trivial but not uniform) WebServer-specific instructions to do so
   driver.installPage(&page1, "/", updateUI);
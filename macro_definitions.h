@@ -37,7 +37,8 @@
  *
  * The user-facing macro here is printFormatted(). This takes static strings and args in a
  * and re-aggranges them so that static strings are merged into one, and the variable args args
- * are appended at the end (suitable for EmbAJAXOutputDriverBase::printContentF(). */
+ * are appended at the end, each preceded by the length of the static segment in front of it
+ * (suitable for EmbAJAXOutputDriverBase::_printSegmentsF()). */
 
 // See https://stackoverflow.com/questions/11761703/overloading-macro-on-number-of-arguments
 #define GET_MACRO(_1,_2,_3,_4,_5,_6,_7,_8,_9,_10,_11,_12,_13,_14,_15,_16,_17,_18,_19,_20,_21,_22,_23,_24,_25,_26,NAME,...) NAME
@@ -77,7 +78,8 @@
      *
      *  Internally, all static portions of the output will be concatenated to a single string, which - on architectures where it matters -
      *  will automatically be wrapped inside an F() macro, for storage in FLASH memory, thus helping a lot to reduce RAM usage (not yet implemented,
-     *  to come soon).
+     *  to come soon). The length of each static segment is determined at compile time, too, so these can be copied to the output in bulk,
+     *  without having to look at each character.
      *
      *  For efficiency reasons, you should try to merge as many bits of output in a single printFormatted(), as possible. I.e. instead of
      *  @code{.cpp}
@@ -91,36 +93,43 @@
      * */
 #define printFormatted(...) printF_(__VA_ARGS__)
 
-#define printF_3(F1, A1a, A1b) printF_proxy((F1 A1a), A1b)
-#define printF_4(F1, A1a, A1b, F2) printF_proxy((F1 A1a F2), A1b)
+#define printF_3(F1, A1a, A1b) printF_proxy((F1 A1a), printF_len(F1), A1b, 0)
+#define printF_4(F1, A1a, A1b, F2) printF_proxy((F1 A1a F2), printF_len(F1), A1b, printF_len(F2))
 //#define printF_5(...) // Not validly possible, as we always follow fmt, arg, fmt, arg...
-#define printF_6(F1, A1a, A1b, F2, A2a, A2b) printF_proxy((F1 A1a F2 A2a), A1b, A2b)
-#define printF_7(F1, A1a, A1b, F2, A2a, A2b, F3) printF_proxy((F1 A1a F2 A2a F3), A1b, A2b)
+#define printF_6(F1, A1a, A1b, F2, A2a, A2b) printF_proxy((F1 A1a F2 A2a), printF_len(F1), A1b, printF_len(F2), A2b, 0)
+#define printF_7(F1, A1a, A1b, F2, A2a, A2b, F3) printF_proxy((F1 A1a F2 A2a F3), printF_len(F1), A1b, printF_len(F2), A2b, printF_len(F3))
 //#define printF_8(...)
-#define printF_9(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b) printF_proxy((F1 A1a F2 A2a F3 A3a), A1b, A2b, A3b)
-#define printF_10(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4) printF_proxy((F1 A1a F2 A2a F3 A3a F4), A1b, A2b, A3b)
+#define printF_9(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b) printF_proxy((F1 A1a F2 A2a F3 A3a), printF_len(F1), A1b, printF_len(F2), A2b, printF_len(F3), A3b, 0)
+#define printF_10(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4) printF_proxy((F1 A1a F2 A2a F3 A3a F4), printF_len(F1), A1b, printF_len(F2), A2b, printF_len(F3), A3b, printF_len(F4))
 //#define printF_11(...)
-#define printF_12(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a), A1b, A2b, A3b, A4b)
-#define printF_13(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5), A1b, A2b, A3b, A4b)
+#define printF_12(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a), printF_len(F1), A1b, printF_len(F2), A2b, printF_len(F3), A3b, printF_len(F4), A4b, 0)
+#define printF_13(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5), printF_len(F1), A1b, printF_len(F2), A2b, printF_len(F3), A3b, printF_len(F4), A4b, printF_len(F5))
 //#define printF_14(...)
-#define printF_15(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a), A1b, A2b, A3b, A4b, A5b)
-#define printF_16(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6), A1b, A2b, A3b, A4b, A5b)
+#define printF_15(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a), printF_len(F1), A1b, printF_len(F2), A2b, printF_len(F3), A3b, printF_len(F4), A4b, printF_len(F5), A5b, 0)
+#define printF_16(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6), printF_len(F1), A1b, printF_len(F2), A2b, printF_len(F3), A3b, printF_len(F4), A4b, printF_len(F5), A5b, printF_len(F6))
 //#define printF_17(...)
-#define printF_18(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a), A1b, A2b, A3b, A4b, A5b, A6b)
-#define printF_19(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b, F7) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a F7), A1b, A2b, A3b, A4b, A5b, A6b)
+#define printF_18(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a), printF_len(F1), A1b, printF_len(F2), A2b, printF_len(F3), A3b, printF_len(F4), A4b, printF_len(F5), A5b, printF_len(F6), A6b, 0)
+#define printF_19(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b, F7) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a F7), printF_len(F1), A1b, printF_len(F2), A2b, printF_len(F3), A3b, printF_len(F4), A4b, printF_len(F5), A5b, printF_len(F6), A6b, printF_len(F7))
 //#define printF_20(...)
-#define printF_21(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b, F7, A7a, A7b) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a F7 A7a), A1b, A2b, A3b, A4b, A5b, A6b, A7b)
-#define printF_22(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b, F7, A7a, A7b, F8) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a F7 A7a F8), A1b, A2b, A3b, A4b, A5b, A6b, A7b)
+#define printF_21(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b, F7, A7a, A7b) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a F7 A7a), printF_len(F1), A1b, printF_len(F2), A2b, printF_len(F3), A3b, printF_len(F4), A4b, printF_len(F5), A5b, printF_len(F6), A6b, printF_len(F7), A7b, 0)
+#define printF_22(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b, F7, A7a, A7b, F8) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a F7 A7a F8), printF_len(F1), A1b, printF_len(F2), A2b, printF_len(F3), A3b, printF_len(F4), A4b, printF_len(F5), A5b, printF_len(F6), A6b, printF_len(F7), A7b, printF_len(F8))
 //#define printF_23(...)
-#define printF_24(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b, F7, A7a, A7b, F8, A8a, A8b) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a F7 A7a F8 A8a), A1b, A2b, A3b, A4b, A5b, A6b, A7b, A8b)
-#define printF_25(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b, F7, A7a, A7b, F8, A8a, A8b, F9) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a F7 A7a F8 A8a F9), A1b, A2b, A3b, A4b, A5b, A6b, A7b, A8b)
+#define printF_24(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b, F7, A7a, A7b, F8, A8a, A8b) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a F7 A7a F8 A8a), printF_len(F1), A1b, printF_len(F2), A2b, printF_len(F3), A3b, printF_len(F4), A4b, printF_len(F5), A5b, printF_len(F6), A6b, printF_len(F7), A7b, printF_len(F8), A8b, 0)
+#define printF_25(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b, F7, A7a, A7b, F8, A8a, A8b, F9) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a F7 A7a F8 A8a F9), printF_len(F1), A1b, printF_len(F2), A2b, printF_len(F3), A3b, printF_len(F4), A4b, printF_len(F5), A5b, printF_len(F6), A6b, printF_len(F7), A7b, printF_len(F8), A8b, printF_len(F9))
+
+// Length of a static segment, passed along, so it can be written in bulk (see EmbAJAXOutputDriverBase::_printSegmentsF())
+#define printF_len(F) ((int) sizeof(F) - 1)
 
 #if USE_PROGMEM_STRINGS
- #define printF_proxy(X, ...) _printContentF(F(X), __VA_ARGS__);
+ #define printF_proxy(X, ...) _printSegmentsF(F(X), __VA_ARGS__);
 #else
- #define printF_proxy(X, ...) _printContentF(X, __VA_ARGS__);
+ #define printF_proxy(X, ...) _printSegmentsF(X, __VA_ARGS__);
 #endif
 
 #ifndef UNUSED
  #define UNUSED(X) (void)(sizeof(X))
 #endif
+
+/** Turn a numeric macro into a string literal (for use inside the static strings, e.g. EMBAJAX_STRINGIFY(EMBAJAX_MAX_ID_LEN) -> "16") */
+#define EMBAJAX_STRINGIFY_(X) #X
+#define EMBAJAX_STRINGIFY(X) EMBAJAX_STRINGIFY_(X)